@@ -0,0 +1,295 @@
+/**
+ * @file: AMBatch.h
+ * Batch of AMAsync calls, that allocate from one arena
+ *
+ * @author Zdeněk Skulínek  &lt;<a href="mailto:zdenek.skulinek@seznam.cz">me@zdenekskulinek.cz</a>&gt;
+ */
+
+#ifndef SAW_ALL_AMBATCH_H
+#define SAW_ALL_AMBATCH_H
+
+#include "AMFuture.h"
+#include <memory_resource>
+#include <algorithm>
+#include <mutex>
+#include <new>
+
+namespace AMCore {
+
+    /**
+     * \brief Monotonic memory resource shared by calls of one batch.
+     *
+     * Allocation bumps offset in the current chunk by compare and swap, only a new chunk takes the lock. Nothing is
+     * freed before the arena is destroyed, then all chunks are returned to the upstream resource at once. The arena
+     * is counted: the batch and every its shared state hold one reference.
+     */
+    class _AMBatchArena : public std::pmr::memory_resource {
+    public:
+        _AMBatchArena(std::size_t chunkSize, std::pmr::memory_resource *upstream) noexcept
+            : m_refs(1), m_current(nullptr), m_chunkSize(std::max<std::size_t>(chunkSize, 256)), m_reserved(0),
+              m_upstream(upstream) {
+        }
+
+        _AMBatchArena(const _AMBatchArena &other) = delete;
+
+        _AMBatchArena &operator=(const _AMBatchArena &other) = delete;
+
+        ~_AMBatchArena() override {
+            Chunk *chunk = m_current.load(std::memory_order_relaxed);
+            while (chunk) {
+                Chunk *previous = chunk->previous;
+                m_upstream->deallocate(chunk, sizeof(Chunk) + chunk->capacity, alignof(std::max_align_t));
+                chunk = previous;
+            }
+        }
+
+        void addRef() noexcept {
+            m_refs.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void release() noexcept {
+            if (m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                delete this;
+            }
+        }
+
+        /**
+         * \brief Number of references, the batch itself included.
+         */
+        std::size_t refs() const noexcept {
+            return m_refs.load(std::memory_order_acquire);
+        }
+
+        /**
+         * \brief Bytes taken from the upstream resource.
+         */
+        std::size_t reserved() const noexcept {
+            return m_reserved.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * \brief Constructs object in the arena. It must be freed by destroy().
+         */
+        template<class U, class... A>
+        U *create(A &&... a) {
+            void *p = allocate(sizeof(U), alignof(U));
+            return ::new(p) U(std::forward<A>(a)...);
+        }
+
+    protected:
+        class Chunk {
+        public:
+            Chunk *previous;
+            std::size_t capacity;
+            std::atomic<std::size_t> used;
+
+            char *data() noexcept {
+                return reinterpret_cast<char *>(this + 1);
+            }
+        };
+
+        void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+            for (;;) {
+                Chunk *chunk = m_current.load(std::memory_order_acquire);
+                if (chunk) {
+                    void *p = bump(chunk, bytes, alignment);
+                    if (p) {
+                        return p;
+                    }
+                }
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_current.load(std::memory_order_relaxed) != chunk) {
+                    // other thread has added chunk meanwhile
+                    continue;
+                }
+                std::size_t capacity = m_chunkSize;
+                while (capacity < bytes + alignment) {
+                    capacity *= 2;
+                }
+                Chunk *next = static_cast<Chunk *>(m_upstream->allocate(sizeof(Chunk) + capacity, alignof(std::max_align_t)));
+                next->previous = chunk;
+                next->capacity = capacity;
+                next->used.store(0, std::memory_order_relaxed);
+                m_reserved.fetch_add(sizeof(Chunk) + capacity, std::memory_order_relaxed);
+                // chunks grow like in std::pmr::monotonic_buffer_resource
+                m_chunkSize = capacity * 2;
+                m_current.store(next, std::memory_order_release);
+            }
+        }
+
+        void do_deallocate(void *p, std::size_t bytes, std::size_t alignment) override {
+            (void) p;
+            (void) bytes;
+            (void) alignment;
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+            return this == &other;
+        }
+
+        static void *bump(Chunk *chunk, std::size_t bytes, std::size_t alignment) noexcept {
+            uintptr_t base = reinterpret_cast<uintptr_t>(chunk->data());
+            std::size_t used = chunk->used.load(std::memory_order_relaxed);
+            for (;;) {
+                uintptr_t start = (base + used + alignment - 1) & ~(uintptr_t) (alignment - 1);
+                std::size_t end = (std::size_t) (start - base) + bytes;
+                if (end > chunk->capacity) {
+                    return nullptr;
+                }
+                if (chunk->used.compare_exchange_weak(used, end, std::memory_order_relaxed)) {
+                    return reinterpret_cast<void *>(start);
+                }
+            }
+        }
+
+        std::atomic<std::size_t> m_refs;
+        std::atomic<Chunk *> m_current;
+        std::size_t m_chunkSize;
+        std::atomic<std::size_t> m_reserved;
+        std::pmr::memory_resource *m_upstream;
+        std::mutex m_mutex;
+    };
+
+    /**
+     * \brief Shared state placed in arena. The last reference destroys it and releases the arena.
+     */
+    template<class State>
+    class _AMBatchState : public State {
+    public:
+        template<class... U>
+        explicit _AMBatchState(_AMBatchArena *arena, U &&... u)
+            : State(std::forward<U>(u)...), m_arena(arena) {
+            m_arena->addRef();
+        }
+
+    protected:
+        void destroy() noexcept override {
+            _AMBatchArena *arena = m_arena;
+            this->~_AMBatchState();
+            arena->release();
+        }
+
+        _AMBatchArena *m_arena;
+    };
+
+    /**
+     * \brief Calls of one request, that share one arena.
+     *
+     * Shared states of calls launched by the batch are allocated from the arena. Tags and results can use it too,
+     * by resource(), for example std::pmr::vector<char> as result of getData(). Memory is never freed one by one,
+     * whole arena is returned to the upstream resource in one step, when the batch and all its calls are gone.
+     * Objects allocated by resource() must not outlive the batch and its futures.
+     *
+     * The batch itself places only shared states in the arena. In multithreaded build the thread of the call and heap
+     * members of copied parameters use the global allocator.
+     *
+     * \code
+     *    AMBatch batch;
+     *    AMFuture<std::pmr::vector<char>> future = AMAsync(batch, AMLaunch::async, &Loader::getData,
+     *        &Loader::isDataAvail, &Loader::prepareData, loader, batch.resource());
+     * \endcode
+     */
+    class AMBatch {
+    public:
+        /**
+         * \brief constructor
+         * @param chunkSize size of the first chunk taken from upstream, further chunks grow
+         * @param upstream resource, that gives chunks
+         */
+        explicit AMBatch(std::size_t chunkSize = 16384, std::pmr::memory_resource *upstream = std::pmr::get_default_resource())
+            : m_arena(new _AMBatchArena(chunkSize, upstream)) {
+        }
+
+        AMBatch(const AMBatch &other) = delete;
+
+        AMBatch &operator=(const AMBatch &other) = delete;
+
+        /**
+         * \brief destructor. Arena is released now, or by the last running call of the batch.
+         */
+        ~AMBatch() {
+            m_arena->release();
+        }
+
+        /**
+         * \brief Arena of the batch. It can be used from any thread, deallocation does nothing.
+         */
+        std::pmr::memory_resource *resource() const noexcept {
+            return m_arena;
+        }
+
+        /**
+         * \brief Constructs tag in the arena. Its destructor is never called.
+         */
+        template<class U, class... A>
+        U *make(A &&... a) {
+            static_assert(std::is_trivially_destructible_v<U>, "AMBatch::make: destructor would not be called");
+            return m_arena->create<U>(std::forward<A>(a)...);
+        }
+
+        /**
+         * \brief Number of calls, whose shared state still exists.
+         */
+        std::size_t pending() const noexcept {
+            return m_arena->refs() - 1;
+        }
+
+        /**
+         * \brief Bytes taken from the upstream resource so far.
+         */
+        std::size_t reserved() const noexcept {
+            return m_arena->reserved();
+        }
+
+        template<class Callback, class AvailCallback, class Function, class TCF, class... Args>
+        AMFuture<std::invoke_result_t<std::decay_t<Callback>, TCF, void *>>
+        launch(_AMAt<AMLaunch> policy, Callback &&callback, AvailCallback &&a, Function &&f, TCF &&tcf, Args &&... args) {
+            typedef std::invoke_result_t<std::decay_t<Callback>, TCF, void *> T;
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+            typedef _AMBatchState<_AMLaunchFnHolder<T, std::decay_t<AvailCallback>, std::decay_t<Callback>, std::remove_reference_t<TCF>, std::decay_t<Function>, std::decay_t<Args>...>> State;
+            State *state = m_arena->create<State>(m_arena, tcf, std::move(a), std::move(callback), std::move(f), std::forward<Args>(args)...);
+            state->watch(policy.site);
+            _AMRunQueue::push(state);
+#else
+            (void) a;
+            typedef _AMBatchState<_AMTaskState<T, std::decay_t<Function>, std::decay_t<Callback>, std::decay_t<TCF>, std::decay_t<Args>...>> State;
+            State *state = m_arena->create<State>(
+                m_arena,
+                std::forward<Function>(f),
+                std::forward<Callback>(callback),
+                std::forward<TCF>(tcf),
+                std::forward<Args>(args)...
+                );
+            state->watch(policy.site);
+            _AMLaunchThread(state, policy.value);
+#endif
+            return AMFuture<T>(state);
+        }
+
+    protected:
+        _AMBatchArena *m_arena;
+    };
+
+    /**
+     * \brief asynchronous call, whose shared state is allocated from arena of batch
+     *
+     * Parameters are the same as for AMAsync.
+     * @param batch batch of the call
+     * @return AMFuture<T>
+     */
+    template<class Callback, class AvailCallback, class Function, class TCF, class... Args>
+    AMFuture<std::invoke_result_t<std::decay_t<Callback>, TCF, void *>>
+    AMAsync(AMBatch &batch, _AMAt<AMLaunch> policy, Callback &&callback, AvailCallback &&a, Function &&f, TCF &&tcf, Args &&... args) {
+        return batch.launch(
+            policy,
+            std::forward<Callback>(callback),
+            std::forward<AvailCallback>(a),
+            std::forward<Function>(f),
+            std::forward<TCF>(tcf),
+            std::forward<Args>(args)...
+            );
+    }
+
+}
+
+#endif //SAW_ALL_AMBATCH_H
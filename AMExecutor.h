@@ -0,0 +1,406 @@
+/**
+ * @file: AMExecutor.h
+ * Executors, that decide where AMAsync calls run
+ *
+ * @author Zdeněk Skulínek  &lt;<a href="mailto:zdenek.skulinek@seznam.cz">me@zdenekskulinek.cz</a>&gt;
+ */
+
+#ifndef SAW_ALL_AMEXECUTOR_H
+#define SAW_ALL_AMEXECUTOR_H
+
+#include "AMFuture.h"
+#include <deque>
+#include <mutex>
+#include <algorithm>
+#include <typeinfo>
+#include <cxxabi.h>
+
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+#include <thread>
+#include <vector>
+#endif
+
+namespace AMCore {
+
+    /**
+     * \brief One AMAsync call handed to an executor.
+     *
+     * Executor calls it exactly once, on any thread. Task, that is destroyed without call, leaves its future
+     * unfinished, so executors must run all accepted tasks.
+     */
+    class AMTask {
+    public:
+        AMTask() noexcept
+            : m_state(nullptr) {
+        }
+
+        explicit AMTask(_AMStateBase *state) noexcept
+            : m_state(state) {
+            m_state->addRef();
+        }
+
+        AMTask(AMTask &&other) noexcept
+            : m_state(other.m_state) {
+            other.m_state = nullptr;
+        }
+
+        AMTask &operator=(AMTask &&other) noexcept {
+            if (this != &other) {
+                reset();
+                m_state = other.m_state;
+                other.m_state = nullptr;
+            }
+            return *this;
+        }
+
+        AMTask(const AMTask &other) = delete;
+
+        AMTask &operator=(const AMTask &other) = delete;
+
+        ~AMTask() {
+            reset();
+        }
+
+        /**
+         * \brief Runs prepareData() of the call and, in multithreaded build, also getData().
+         */
+        void operator()() noexcept {
+            assert(m_state);
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+            // get() may have run the call already
+            m_state->runDeferred();
+#else
+            m_state->run();
+#endif
+            reset();
+        }
+
+        explicit operator bool() const noexcept {
+            return m_state != nullptr;
+        }
+
+    protected:
+        void reset() noexcept {
+            if (m_state) {
+                m_state->release();
+                m_state = nullptr;
+            }
+        }
+
+        _AMStateBase *m_state;
+    };
+
+    /**
+     * \brief Runs the call directly in AMAsync. AMAsync with this executor does not pass any task.
+     *
+     * Derive own executor from it to get the same treatment.
+     */
+    class AMInlineExecutor {
+    public:
+        void execute(AMTask task) noexcept {
+            task();
+        }
+    };
+
+    /**
+     * \brief Collects calls, until the owner runs them. Use it to put calls into own event loop.
+     */
+    class AMManualExecutor {
+    public:
+        AMManualExecutor() = default;
+
+        AMManualExecutor(const AMManualExecutor &other) = delete;
+
+        AMManualExecutor &operator=(const AMManualExecutor &other) = delete;
+
+        /**
+         * \brief destructor. Runs remaining calls, so that no future is left unfinished.
+         */
+        ~AMManualExecutor() {
+            run();
+        }
+
+        void execute(AMTask task) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_tasks.push_back(std::move(task));
+        }
+
+        /**
+         * \brief Runs the oldest call.
+         * @return false, if there was no call
+         */
+        bool run_one() {
+            AMTask task;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_tasks.empty()) {
+                    return false;
+                }
+                task = std::move(m_tasks.front());
+                m_tasks.pop_front();
+            }
+            task();
+            return true;
+        }
+
+        /**
+         * \brief Runs calls, until there is none. Calls added meanwhile are run too.
+         * @return number of run calls
+         */
+        std::size_t run() {
+            std::size_t count = 0;
+            while (run_one()) {
+                ++count;
+            }
+            return count;
+        }
+
+        /**
+         * \brief Runs calls, until there is none or budget is spent. At least one call is run.
+         * @param budget time, that can be spent
+         * @return number of run calls
+         */
+        std::size_t run_for(std::chrono::microseconds budget) {
+            auto deadline = std::chrono::steady_clock::now() + budget;
+            std::size_t count = 0;
+            while (run_one()) {
+                ++count;
+                if (std::chrono::steady_clock::now() >= deadline) {
+                    break;
+                }
+            }
+            return count;
+        }
+
+        /**
+         * \brief Number of calls, that wait for run.
+         */
+        std::size_t size() const {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_tasks.size();
+        }
+
+    protected:
+        std::deque<AMTask> m_tasks;
+        mutable std::mutex m_mutex;
+    };
+
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+    /**
+     * \brief Runs calls on fixed number of long-lived threads, instead of thread per call.
+     *
+     * Idle workers stay warm: they spin with pause, then yield, and only then park on futex. The spin window follows
+     * the recent arrival rate of calls, see \ref AMIdleProfile. Threads are woken only, when some of them sleep.
+     */
+    class AMThreadPoolExecutor {
+    public:
+        /**
+         * \brief constructor
+         * @param threads number of worker threads
+         */
+        explicit AMThreadPoolExecutor(unsigned threads = std::max(1u, std::thread::hardware_concurrency()))
+            : m_queued(0), m_event(0), m_sleepers(0), m_stop(false), m_parks(0) {
+            assert(threads > 0);
+            for (unsigned i = 0; i < threads; ++i) {
+                m_threads.emplace_back([this]() {
+                    work();
+                });
+            }
+        }
+
+        AMThreadPoolExecutor(const AMThreadPoolExecutor &other) = delete;
+
+        AMThreadPoolExecutor &operator=(const AMThreadPoolExecutor &other) = delete;
+
+        /**
+         * \brief destructor. Runs remaining calls and joins threads.
+         */
+        ~AMThreadPoolExecutor() {
+            m_stop.store(true, std::memory_order_seq_cst);
+            m_event.fetch_add(1, std::memory_order_seq_cst);
+            _AMParker::wakeAll(m_event);
+            for (std::thread &thread: m_threads) {
+                thread.join();
+            }
+        }
+
+        void execute(AMTask task) {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_tasks.push_back(std::move(task));
+                m_queued.fetch_add(1, std::memory_order_relaxed);
+            }
+            // pairs with the fence of parking worker, one of them sees the other
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (m_sleepers.load(std::memory_order_relaxed)) {
+                m_event.fetch_add(1, std::memory_order_release);
+                _AMParker::wakeOne(m_event);
+            }
+        }
+
+        /**
+         * \brief Number of worker threads.
+         */
+        std::size_t size() const {
+            return m_threads.size();
+        }
+
+        /**
+         * \brief How many times workers went to sleep. Spinning workers don't.
+         */
+        uint64_t parks() const noexcept {
+            return m_parks.load(std::memory_order_relaxed);
+        }
+
+    protected:
+        bool hasWork() const noexcept {
+            return m_queued.load(std::memory_order_acquire) != 0 || m_stop.load(std::memory_order_acquire);
+        }
+
+        void work() {
+            for (;;) {
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    if (!m_tasks.empty()) {
+                        AMTask task = std::move(m_tasks.front());
+                        m_tasks.pop_front();
+                        m_queued.fetch_sub(1, std::memory_order_relaxed);
+                        lock.unlock();
+                        task();
+                        continue;
+                    }
+                }
+                if (m_stop.load(std::memory_order_acquire)) {
+                    return;
+                }
+                // idle time is the gap between calls, it tunes the spin window
+                int64_t start = _AMIdle::now();
+                if (!m_idle.idle([this]() { return hasWork(); })) {
+                    uint32_t seq = m_event.load(std::memory_order_acquire);
+                    m_sleepers.fetch_add(1, std::memory_order_relaxed);
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                    if (!hasWork()) {
+                        m_parks.fetch_add(1, std::memory_order_relaxed);
+                        _AMParker::wait(m_event, seq, nullptr);
+                    }
+                    m_sleepers.fetch_sub(1, std::memory_order_relaxed);
+                }
+                m_idle.record(_AMIdle::now() - start);
+            }
+        }
+
+        std::deque<AMTask> m_tasks;
+        std::mutex m_mutex;
+        std::atomic<uint32_t> m_queued;
+        std::atomic<uint32_t> m_event;
+        std::atomic<uint32_t> m_sleepers;
+        std::atomic<bool> m_stop;
+        std::atomic<uint64_t> m_parks;
+        _AMIdle m_idle;
+        std::vector<std::thread> m_threads;
+    };
+#endif
+
+    /**
+     * \brief Readable name of type F. It is made once and kept for the whole program.
+     */
+    template<class F>
+    const char *_AMTypeName() noexcept {
+        static const char *name = []() noexcept {
+            int status = 0;
+            char *demangled = abi::__cxa_demangle(typeid(F).name(), nullptr, nullptr, &status);
+            return status == 0 && demangled ? demangled : typeid(F).name();
+        }();
+        return name;
+    }
+
+    /**
+     * \brief Type of AMAsync with executor. Only classes with execute(AMTask) are executors.
+     */
+    template<class Executor, class R, class = void>
+    class _AMIfExecutor {
+    };
+
+    template<class Executor, class R>
+    class _AMIfExecutor<Executor, R, std::void_t<decltype(std::declval<Executor &>().execute(std::declval<AMTask>()))>> {
+    public:
+        typedef R type;
+    };
+
+    /**
+     * \brief Creates shared state of call and hands it to executor.
+     */
+    class _AMExecutorLaunch {
+    public:
+        template<class Executor, class Callback, class AvailCallback, class Function, class TCF, class... Args>
+        static AMFuture<std::invoke_result_t<std::decay_t<Callback>, TCF, void *>>
+        launch(Executor &executor, Callback &&callback, AvailCallback &&a, Function &&f, TCF &&tcf, Args &&... args) {
+            typedef std::invoke_result_t<std::decay_t<Callback>, TCF, void *> T;
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+            typedef _AMLaunchFnHolder<T, std::decay_t<AvailCallback>, std::decay_t<Callback>, std::remove_reference_t<TCF>, std::decay_t<Function>, std::decay_t<Args>...> State;
+            State *state = new State(tcf, std::move(a), std::move(callback), std::move(f), std::forward<Args>(args)...);
+            state->watch(_AMCallSite(_AMTypeName<std::decay_t<Function>>(), 0));
+            if constexpr (std::is_base_of_v<AMInlineExecutor, Executor>) {
+                state->runDeferred();
+            } else {
+                try {
+                    executor.execute(AMTask(state));
+                } catch (...) {
+                    state->release();
+                    throw;
+                }
+            }
+#else
+            (void) a;
+            typedef _AMTaskState<T, std::decay_t<Function>, std::decay_t<Callback>, std::decay_t<TCF>, std::decay_t<Args>...> State;
+            State *state = new State(
+                std::forward<Function>(f),
+                std::forward<Callback>(callback),
+                std::forward<TCF>(tcf),
+                std::forward<Args>(args)...
+                );
+            state->watch(_AMCallSite(_AMTypeName<std::decay_t<Function>>(), 0));
+            if constexpr (std::is_base_of_v<AMInlineExecutor, Executor>) {
+                // the state is ready before anybody can wait, so nobody parks and nobody is woken
+                state->run();
+            } else {
+                try {
+                    executor.execute(AMTask(state));
+                } catch (...) {
+                    state->release();
+                    throw;
+                }
+            }
+#endif
+            return AMFuture<T>(state);
+        }
+    };
+
+    /**
+     * \brief asynchronous call placed by executor
+     *
+     * Executor is any class with method execute(AMTask), that calls the task once, somewhere. Built-in executors are
+     * \ref AMInlineExecutor, \ref AMManualExecutor and, in multithreaded build, \ref AMThreadPoolExecutor.
+     * Other parameters are the same as for AMAsync with AMLaunch policy. The path of the call is compiled for each
+     * executor. Its type is deduced, so the call site cannot be filled in by compiler: without \ref AMWatchSite
+     * (or AM_WATCH_SITE() for file and line) the watchdog names the call by type of prepareData.
+     *
+     * @param executor executor, that runs the call
+     * @return AMFuture<T>
+     */
+    template<class Executor, class Callback, class AvailCallback, class Function, class TCF, class... Args>
+    typename _AMIfExecutor<Executor, AMFuture<std::invoke_result_t<std::decay_t<Callback>, TCF, void *>>>::type
+    AMAsync(Executor &executor, Callback &&callback, AvailCallback &&a, Function &&f, TCF &&tcf, Args &&... args) {
+        return _AMExecutorLaunch::launch(
+            executor,
+            std::forward<Callback>(callback),
+            std::forward<AvailCallback>(a),
+            std::forward<Function>(f),
+            std::forward<TCF>(tcf),
+            std::forward<Args>(args)...
+            );
+    }
+
+}
+
+#endif //SAW_ALL_AMEXECUTOR_H
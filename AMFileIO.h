@@ -0,0 +1,196 @@
+/**
+ * @file: AMFileIO.h
+ * Asynchronous reads of local files for prepareData / isDataAvail / getData
+ *
+ * @author Zdeněk Skulínek  &lt;<a href="mailto:zdenek.skulinek@seznam.cz">me@zdenekskulinek.cz</a>&gt;
+ */
+
+#ifndef SAW_ALL_AMFILEIO_H
+#define SAW_ALL_AMFILEIO_H
+
+#include "AMFuture.h"
+#include <vector>
+#include <system_error>
+#include <cerrno>
+#include <unistd.h>
+
+namespace AMCore {
+
+    /**
+     * \brief Shared state of one read. Data are read directly into the buffer, that getData() hands over.
+     */
+    class _AMReadState : public _AMValueState<std::vector<char>> {
+    public:
+        _AMReadState(int fd, std::size_t size, std::uint64_t offset)
+            : m_fd(fd), m_offset(offset), m_buffer(size), m_done(0), m_previous(nullptr), m_next(nullptr) {
+        }
+
+        /**
+         * \brief Stores result of the read and wakes waiters.
+         * @param result number of read bytes, or negative errno
+         */
+        void finish(long result) noexcept {
+            fulfil([this, result]() -> std::vector<char> {
+                if (result < 0) {
+                    throw std::system_error((int) -result, std::generic_category(), "AMFileIO read");
+                }
+                m_buffer.resize((std::size_t) result);
+                return std::move(m_buffer);
+            });
+        }
+
+        /**
+         * \brief Reads buffer with blocking calls, short only at the end of file.
+         * @return number of read bytes, or negative errno
+         */
+        long readBlocking() noexcept {
+            std::size_t done = 0;
+            while (done < m_buffer.size()) {
+                ssize_t n = ::pread(m_fd, m_buffer.data() + done, m_buffer.size() - done, (off_t) (m_offset + done));
+                if (n < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    return -errno;
+                }
+                if (n == 0) {
+                    break;
+                }
+                done += (std::size_t) n;
+            }
+            return (long) done;
+        }
+
+        int m_fd;
+        std::uint64_t m_offset;
+        std::vector<char> m_buffer;
+        std::size_t m_done; ///< bytes read by earlier parts of short io_uring read
+        _AMReadState *m_previous; ///< list of reads handed to io_uring
+        _AMReadState *m_next;
+    };
+
+    /**
+     * \brief Reads of local files, that need no thread per read.
+     *
+     * On Linux, reads are submitted to io_uring and one thread collects all completions. Where io_uring is not
+     * available, few worker threads do blocking reads. In singlethreaded build, read completes in prepareRead().
+     *
+     * In multithreaded build, read() is the way: the completion thread fulfils the future directly. AMAsync with
+     * the callbacks below would block its own thread in getData() for every read. In singlethreaded build, use
+     * them inside own prepareData / isDataAvail / getData:
+     *
+     * \code
+     *    void *prepareData(int fd) { return io->prepareRead(fd, 4096, 0); }
+     *    bool isDataAvail(void *tag) { return io->isDataAvail(tag); }
+     *    std::vector<char> getData(void *tag) { return io->getData(tag); }
+     * \endcode
+     */
+    class AMFileIO {
+    public:
+        enum class Backend {
+            automatic, ///< io_uring, if it is available, otherwise threads
+            uring,     ///< io_uring and one completion thread
+            threads,   ///< worker threads with blocking reads
+            blocking   ///< read completes in prepareRead(), singlethreaded build
+        };
+
+        /**
+         * \brief constructor
+         * @param depth maximal number of reads submitted to the kernel at once, further reads wait in a queue
+         * @param backend requested backend. Unavailable io_uring falls back to threads.
+         */
+        explicit AMFileIO(unsigned depth = 64, Backend backend = Backend::automatic);
+
+        AMFileIO(const AMFileIO &other) = delete;
+
+        AMFileIO &operator=(const AMFileIO &other) = delete;
+
+        /**
+         * \brief destructor. Waits for submitted reads.
+         */
+        ~AMFileIO();
+
+        /**
+         * \brief Backend, that is really used.
+         */
+        Backend backend() const noexcept;
+
+        /**
+         * \brief Submits read. Every returned tag must be passed to getData() once.
+         * @param fd open file
+         * @param size number of bytes to read
+         * @param offset position in the file
+         * @return tag of the read
+         */
+        void *prepareRead(int fd, std::size_t size, std::uint64_t offset) {
+            _AMReadState *state = new _AMReadState(fd, size, offset);
+            state->watch(_AMCallSite("AMFileIO::prepareRead", 0));
+            submit(state);
+            return state;
+        }
+
+        /**
+         * \brief Checks, that the read of tag has completed.
+         */
+        bool isDataAvail(void *tag) const noexcept {
+            return static_cast<_AMReadState *>(tag)->isReady();
+        }
+
+        /**
+         * \brief Waits for the read and hands over its buffer. The buffer is not copied.
+         * @param tag tag returned by prepareRead()
+         * @return read bytes, shorter than requested at the end of file
+         * @throw std::system_error read failed
+         */
+        std::vector<char> getData(void *tag) {
+            _AMReadState *state = static_cast<_AMReadState *>(tag);
+            struct Release {
+                _AMReadState *state;
+                ~Release() { state->release(); }
+            } release{state};
+            state->wait();
+            return state->take();
+        }
+
+        /**
+         * \brief Submits read and returns its future, that is fulfilled by the completion thread directly.
+         */
+        AMFuture<std::vector<char>> read(int fd, std::size_t size, std::uint64_t offset) {
+            return AMFuture<std::vector<char>>(static_cast<_AMReadState *>(prepareRead(fd, size, offset)));
+        }
+
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+    protected:
+        void submit(_AMReadState *state) {
+            state->finish(state->readBlocking());
+        }
+#else
+        /**
+         * \brief Backend implementation, see src/AMFileIO.cpp.
+         */
+        class Engine;
+
+    protected:
+        void submit(_AMReadState *state);
+
+        Engine *m_engine;
+#endif
+    };
+
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+    inline AMFileIO::AMFileIO(unsigned depth, Backend backend) {
+        (void) depth;
+        (void) backend;
+    }
+
+    inline AMFileIO::~AMFileIO() {
+    }
+
+    inline AMFileIO::Backend AMFileIO::backend() const noexcept {
+        return Backend::blocking;
+    }
+#endif
+
+}
+
+#endif //SAW_ALL_AMFILEIO_H
@@ -13,9 +13,21 @@
 #include <chrono>
 #include <type_traits>
 #include <cassert>
+#include <atomic>
+#include <optional>
+#include <exception>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <stdexcept>
+#include <algorithm>
 
 #if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
 
+#include <set>
+#include <tuple>
+#include <algorithm>
+
 namespace AMCore {
 
     enum class AMFutureStatus
@@ -29,64 +41,934 @@ namespace AMCore {
         async =  0
     };
 
+    class _AMParker
+    {
+    public:
+        // single threaded build never sleeps, nobody else could wake it up
+        static void wait(std::atomic<uint32_t>& word, uint32_t expected, const std::chrono::nanoseconds* timeout)
+        {
+            (void)word;
+            (void)expected;
+            (void)timeout;
+        }
+        static void wakeAll(std::atomic<uint32_t>& word)
+        {
+            (void)word;
+        }
+        static void wakeOne(std::atomic<uint32_t>& word)
+        {
+            (void)word;
+        }
+        static void relax() noexcept
+        {
+        }
+        static constexpr int spinIterations = 0;
+    };
+
+    // <future> is not available without threads
+    inline std::exception_ptr _AMBrokenPromise()
+    {
+        return std::make_exception_ptr(std::logic_error("AMPromise destroyed without result"));
+    }
+
+    inline void _AMPromiseSatisfied()
+    {
+        throw std::logic_error("AMPromise already satisfied");
+    }
+
+    inline void _AMFutureRetrieved()
+    {
+        throw std::logic_error("AMPromise future already retrieved");
+    }
+
+}
+#else
+
+#include <future>
+#include <set>
+#include <mutex>
+#include <thread>
+#include <tuple>
+
+namespace AMCore {
+
+    /**
+     * \brief Status of future is exacly the same as std::future_status
+     */
+    typedef std::future_status AMFutureStatus;
+
+    /**
+     * \brief Launch mode is exactly the same as std::launch
+     */
+    typedef std::launch AMLaunch;
+
+    /**
+     * \brief Parks and wakes threads waiting on a 32-bit atomic word.
+     *
+     * Uses futex on Linux and hashed condition variables elsewhere.
+     */
+    class _AMParker {
+    public:
+        /**
+         * \brief Sleeps while word equals expected. Spurious wake-ups are allowed.
+         * @param word watched word
+         * @param expected value, that keeps thread sleeping
+         * @param timeout maximal time of sleep, nullptr for no limit
+         */
+        static void wait(std::atomic<uint32_t> &word, uint32_t expected, const std::chrono::nanoseconds *timeout);
+
+        /**
+         * \brief Wakes all threads sleeping on word.
+         * @param word watched word
+         */
+        static void wakeAll(std::atomic<uint32_t> &word);
+
+        /**
+         * \brief Wakes at least one thread sleeping on word.
+         * @param word watched word
+         */
+        static void wakeOne(std::atomic<uint32_t> &word);
+
+        /**
+         * \brief CPU hint for busy waiting loop.
+         */
+        static void relax() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+            asm volatile("yield");
+#endif
+        }
+
+        /**
+         * \brief Number of checks of the word before thread goes to sleep.
+         */
+        static constexpr int spinIterations = 128;
+    };
+
+    inline std::exception_ptr _AMBrokenPromise() {
+        return std::make_exception_ptr(std::future_error(std::future_errc::broken_promise));
+    }
+
+    inline void _AMPromiseSatisfied() {
+        throw std::future_error(std::future_errc::promise_already_satisfied);
+    }
+
+    inline void _AMFutureRetrieved() {
+        throw std::future_error(std::future_errc::future_already_retrieved);
+    }
+
+}
+#endif
+
+namespace AMCore {
+
+    /**
+     * \brief Thrown by AMFuture::get(), when deadline of the future expired before the result.
+     */
+    class AMFutureTimeout : public std::runtime_error {
+    public:
+        AMFutureTimeout()
+            : std::runtime_error("AMFuture deadline expired") {
+        }
+    };
+
+    /**
+     * \brief How threads wait, that have nothing to do: AMFuture::get() and workers of AMThreadPoolExecutor.
+     */
+    enum class AMIdleProfile {
+        lowLatency,   ///< spin and yield for a window adapted to recent waits, then park
+        powerSaving   ///< short fixed spin, then park
+    };
+
+    inline std::atomic<AMIdleProfile> &_AMIdleProfileWord() noexcept {
+        static std::atomic<AMIdleProfile> m_profile(AMIdleProfile::lowLatency);
+        return m_profile;
+    }
+
+    /**
+     * \brief Switches idle profile of all waiting threads. It can be changed anytime, waits in progress keep
+     * the old one.
+     */
+    inline void AMSetIdleProfile(AMIdleProfile profile) noexcept {
+        _AMIdleProfileWord().store(profile, std::memory_order_relaxed);
+    }
+
+    inline AMIdleProfile AMGetIdleProfile() noexcept {
+        return _AMIdleProfileWord().load(std::memory_order_relaxed);
+    }
+
+    /**
+     * \brief Adaptive spin window of one kind of waiting.
+     *
+     * Keeps moving average of recent waits. Waits, that usually end within the window, spin with pause and then
+     * yield, before the thread parks. When waits are much longer, the next result is far away, so waiting threads
+     * spin only briefly and park. Singlethreaded build never waits.
+     */
+    class _AMIdle {
+    public:
+        static constexpr int64_t minSpinNs = 1000;
+        static constexpr int64_t maxSpinNs = 50000;
+
+        _AMIdle() noexcept
+            : m_average(maxSpinNs / 4) {
+        }
+
+        /**
+         * \brief Window of waiters in AMFuture::get().
+         */
+        static _AMIdle &waiters() noexcept {
+            static _AMIdle m_waiters;
+            return m_waiters;
+        }
+
+        static int64_t now() noexcept {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        /**
+         * \brief Spins, then yields, until ready() is true or the window is over.
+         * @param limitNs waiting must end by then
+         * @return false, if the thread should park
+         */
+        template<class Ready>
+        bool idle(Ready &&ready, int64_t limitNs = INT64_MAX) const noexcept {
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+            (void) limitNs;
+            return ready();
+#else
+            if (AMGetIdleProfile() == AMIdleProfile::powerSaving) {
+                for (int i = 0; i < _AMParker::spinIterations; ++i) {
+                    if (ready()) {
+                        return true;
+                    }
+                    _AMParker::relax();
+                }
+                return ready();
+            }
+            int64_t spinNs = spinWindow();
+            int64_t start = now();
+            // on single core, spinning only delays the thread, that is waited for
+            int64_t spinEnd = multicore() ? std::min(limitNs, start + spinNs) : start;
+            // waits longer than the window do not yield, parking is cheaper
+            int64_t yieldEnd = spinNs > minSpinNs ? std::min(limitNs, start + 4 * spinNs) : spinEnd;
+            for (int i = 1;; ++i) {
+                if (ready()) {
+                    return true;
+                }
+                if (i % 16 == 0) {
+                    int64_t t = now();
+                    if (t >= yieldEnd) {
+                        return ready();
+                    }
+                    if (t >= spinEnd) {
+                        std::this_thread::yield();
+                        continue;
+                    }
+                }
+                _AMParker::relax();
+            }
+#endif
+        }
+
+        /**
+         * \brief Remembers length of finished wait.
+         */
+        void record(int64_t waitedNs) noexcept {
+            int64_t average = m_average.load(std::memory_order_relaxed);
+            m_average.store(average + (std::min(waitedNs, 64 * maxSpinNs) - average) / 8, std::memory_order_relaxed);
+        }
+
+        /**
+         * \brief Current spin window. Twice the average wait, nothing above the maximum is worth spinning.
+         */
+        int64_t spinWindow() const noexcept {
+            int64_t average = m_average.load(std::memory_order_relaxed);
+            if (average > 4 * maxSpinNs) {
+                return minSpinNs;
+            }
+            return std::max(minSpinNs, std::min(maxSpinNs, 2 * average));
+        }
+
+    protected:
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+        static bool multicore() noexcept {
+            static const bool m_multicore = std::thread::hardware_concurrency() != 1;
+            return m_multicore;
+        }
+#endif
+
+        std::atomic<int64_t> m_average;
+    };
+
+    /**
+     * \brief Receives notification, that a shared state became ready.
+     */
+    class _AMStateListener {
+    public:
+        /**
+         * \brief Called once, by the thread that made the state ready.
+         */
+        virtual void onReady() noexcept = 0;
+
+    protected:
+        ~_AMStateListener() {
+        }
+    };
+
+    /**
+     * \brief Table of running AMAsync calls for \ref AMWatchdog.
+     *
+     * Fixed number of slots, claimed and released by compare and swap, so launch and completion never lock.
+     * Calls, that find no free slot, are only counted.
+     */
+    class _AMWatchTable {
+    public:
+#ifndef AMFUTURE_WATCHDOG_SLOTS
+        static constexpr std::size_t slots = 1024;
+#else
+        static constexpr std::size_t slots = AMFUTURE_WATCHDOG_SLOTS;
+#endif
+        enum : uint32_t {
+            flagZombie = 1u,
+            flagReported = 2u
+        };
+
+        class Entry {
+        public:
+            std::atomic<const void *> owner{nullptr};
+            std::atomic<int64_t> start{0};
+            std::atomic<const char *> site{nullptr};
+            std::atomic<int32_t> line{0};
+            std::atomic<uint32_t> flags{0};
+        };
+
+        static std::atomic<bool> &enabled() noexcept {
+            static std::atomic<bool> m_enabled(false);
+            return m_enabled;
+        }
+
+        static _AMWatchTable &instance() noexcept {
+            static _AMWatchTable m_table;
+            return m_table;
+        }
+
+        /**
+         * \brief Call site label of calls launched by this thread, see AMWatchSite.
+         */
+        static const char *&threadSite() noexcept {
+            static thread_local const char *m_site = nullptr;
+            return m_site;
+        }
+
+        static int64_t now() noexcept {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        /**
+         * \brief Claims slot for owner.
+         * @return index of the slot, or -1, if the table is full
+         */
+        int32_t enter(const void *owner, const char *site, int32_t line) noexcept {
+            std::size_t first = (reinterpret_cast<uintptr_t>(owner) >> 4) % slots;
+            for (std::size_t n = 0; n < slots; ++n) {
+                std::size_t i = (first + n) % slots;
+                const void *expected = nullptr;
+                if (m_entries[i].owner.load(std::memory_order_relaxed) == nullptr &&
+                    m_entries[i].owner.compare_exchange_strong(expected, owner, std::memory_order_acquire)) {
+                    m_entries[i].site.store(site, std::memory_order_relaxed);
+                    m_entries[i].line.store(line, std::memory_order_relaxed);
+                    m_entries[i].flags.store(0, std::memory_order_relaxed);
+                    m_entries[i].start.store(now(), std::memory_order_release);
+                    return (int32_t) i;
+                }
+            }
+            m_untracked.fetch_add(1, std::memory_order_relaxed);
+            return -1;
+        }
+
+        void leave(int32_t slot, const void *owner) noexcept {
+            Entry &e = m_entries[slot];
+            if (e.owner.load(std::memory_order_relaxed) == owner) {
+                e.start.store(0, std::memory_order_relaxed);
+                e.owner.store(nullptr, std::memory_order_release);
+            }
+        }
+
+        void mark(int32_t slot, const void *owner, uint32_t flag) noexcept {
+            Entry &e = m_entries[slot];
+            if (e.owner.load(std::memory_order_relaxed) == owner) {
+                e.flags.fetch_or(flag, std::memory_order_relaxed);
+            }
+        }
+
+        Entry m_entries[slots];
+        std::atomic<uint64_t> m_untracked{0};
+    };
+
+    /**
+     * \brief Place of a call in source. Default arguments are filled in by compiler at the place of the call.
+     */
+    class _AMCallSite {
+    public:
+        constexpr _AMCallSite(const char *_file = __builtin_FILE(), int _line = __builtin_LINE()) noexcept
+            : file(_file), line(_line) {
+        }
+
+        const char *file;
+        int line;
+    };
+
+    /**
+     * \brief Leading parameter of AMAsync, that also remembers the call site for \ref AMWatchdog.
+     *
+     * Converts implicitly from T, so callers pass the plain value.
+     */
+    template<class T>
+    class _AMAt {
+    public:
+        _AMAt(T _value, const char *_file = __builtin_FILE(), int _line = __builtin_LINE()) noexcept
+            : value(_value), site(_file, _line) {
+        }
+
+        T value;
+        _AMCallSite site;
+    };
+
+    /**
+     * \brief Type independent part of shared state between AMFuture and launched task.
+     *
+     * Whole synchronization is one atomic word. Waiters spin for a while and then park on it.
+     */
+    class _AMStateBase {
+    public:
+        enum : uint32_t {
+            stateReady = 1u,
+            stateWaiters = 2u,
+            stateListener = 4u,
+            stateNotified = 8u,
+            stateClaimed = 16u,
+            stateExpired = 32u,
+            stateProduced = 64u
+        };
+
+        _AMStateBase() noexcept
+            : m_state(0), m_refs(1), m_deferred(false), m_listener(nullptr), m_watchSlot(-1) {
+        }
+
+        virtual ~_AMStateBase() {
+            unwatch();
+        }
+
+        void addRef() noexcept {
+            m_refs.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void release() noexcept {
+            if (m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                destroy();
+            }
+        }
+
+        bool isReady() const noexcept {
+            return (m_state.load(std::memory_order_acquire) & stateReady) != 0;
+        }
+
+        /**
+         * \brief Checks, that the state was completed by expire() instead of its producer.
+         */
+        bool isExpired() const noexcept {
+            return (m_state.load(std::memory_order_acquire) & stateExpired) != 0;
+        }
+
+        /**
+         * \brief Checks, that the state is ready and its producer does not run anymore.
+         */
+        bool isSettled() const noexcept {
+            uint32_t s = m_state.load(std::memory_order_acquire);
+            return (s & stateReady) && (s & stateProduced);
+        }
+
+        /**
+         * \brief Completes the state before its producer. Result of the producer will be thrown away.
+         * @return false, if the state was already completed
+         */
+        bool expire() noexcept {
+            uint32_t s = m_state.load(std::memory_order_relaxed);
+            do {
+                if (s & stateClaimed) {
+                    return false;
+                }
+            } while (!m_state.compare_exchange_weak(s, s | stateClaimed | stateExpired, std::memory_order_acq_rel));
+            markReady();
+            return true;
+        }
+
+        /**
+         * \brief Checks readiness. States, that can't signal readiness themselves, ask their data source here.
+         * @return true, if the state is ready
+         */
+        virtual bool poll() {
+            return isReady();
+        }
+
+        bool isDeferred() const noexcept {
+            return m_deferred;
+        }
+
+        /**
+         * \brief Marks the state as deferred: its task is run by the first waiter.
+         */
+        void defer() noexcept {
+            m_deferred = true;
+        }
+
+        /**
+         * \brief Runs task of the state. Only tasks launched with AMLaunch::deferred are run by waiter.
+         */
+        virtual void run() noexcept {
+        }
+
+        /**
+         * \brief Runs task of deferred state, if it has not run yet.
+         */
+        void runDeferred() noexcept {
+            if (m_deferred) {
+                m_deferred = false;
+                run();
+            }
+        }
+
+        /**
+         * \brief Attaches the only listener of the state.
+         * @param listener called, when the state becomes ready
+         * @return false, if the state is already ready and listener will not be called
+         */
+        bool attach(_AMStateListener *listener) noexcept {
+            assert(!(m_state.load(std::memory_order_relaxed) & stateListener));
+            m_listener = listener;
+            if (m_state.fetch_or(stateListener, std::memory_order_acq_rel) & stateReady) {
+                m_state.fetch_or(stateNotified, std::memory_order_release);
+                return false;
+            }
+            return true;
+        }
+
+        /**
+         * \brief Detaches listener. If the listener is just being called, waits for it.
+         */
+        void detach() noexcept {
+            uint32_t old = m_state.fetch_and(~(uint32_t)stateListener, std::memory_order_acq_rel);
+            if ((old & stateListener) && (old & stateReady)) {
+                while (!(m_state.load(std::memory_order_acquire) & stateNotified)) {
+                    _AMParker::relax();
+                }
+            }
+        }
+
+        void wait();
+
+        template<class Clock, class Duration>
+        bool waitUntil(const std::chrono::time_point<Clock, Duration> &timeout_time);
+
+        /**
+         * \brief Registers launched call with watchdog, if it is enabled. Called before the producer starts.
+         * @param site place of the call, label of AMWatchSite takes precedence
+         */
+        void watch(const _AMCallSite &site) noexcept {
+            if (_AMWatchTable::enabled().load(std::memory_order_relaxed)) {
+                const char *label = _AMWatchTable::threadSite();
+                m_watchSlot = label ? _AMWatchTable::instance().enter(this, label, 0) : _AMWatchTable::instance().enter(this, site.file, site.line);
+            }
+        }
+
+        /**
+         * \brief Marks watched call, that nobody waits for anymore.
+         */
+        void watchZombie() noexcept {
+            if (m_watchSlot >= 0) {
+                _AMWatchTable::instance().mark(m_watchSlot, this, _AMWatchTable::flagZombie);
+            }
+        }
+
+    protected:
+        /**
+         * \brief Frees the state after the last reference. States, that are not allocated by new, override it.
+         */
+        virtual void destroy() noexcept {
+            delete this;
+        }
+
+        /**
+         * \brief Called by producer, when result is stored. Wakes waiters, unless the state has expired.
+         */
+        void complete() noexcept {
+            unwatch();
+            if (!(m_state.fetch_or(stateClaimed | stateProduced, std::memory_order_acq_rel) & stateClaimed)) {
+                markReady();
+            }
+        }
+
+        /**
+         * \brief Claims the right to make the state ready, for states with more producers.
+         * @return false, if the state was already claimed
+         */
+        bool claim() noexcept {
+            return !(m_state.fetch_or(stateClaimed, std::memory_order_acq_rel) & stateClaimed);
+        }
+
+        /**
+         * \brief Marks, that no producer of the state runs anymore. Until then, the state is not settled.
+         */
+        void finishProducers() noexcept {
+            unwatch();
+            m_state.fetch_or(stateProduced, std::memory_order_release);
+        }
+
+        void unwatch() noexcept {
+            if (m_watchSlot >= 0) {
+                _AMWatchTable::instance().leave(m_watchSlot, this);
+            }
+        }
+
+        void markReady() noexcept {
+            uint32_t old = m_state.fetch_or(stateReady, std::memory_order_acq_rel);
+            if (old & stateWaiters) {
+                _AMParker::wakeAll(m_state);
+            }
+            if (old & stateListener) {
+                m_listener->onReady();
+                m_state.fetch_or(stateNotified, std::memory_order_release);
+            }
+        }
+
+        bool spin(int64_t limitNs) const noexcept {
+            return _AMIdle::waiters().idle([this]() {
+                return isReady();
+            }, limitNs);
+        }
+
+        bool park(const std::chrono::nanoseconds *timeout) {
+            uint32_t s = m_state.load(std::memory_order_acquire);
+            if (s & stateReady) {
+                return true;
+            }
+            if (!(s & stateWaiters)) {
+                if (!m_state.compare_exchange_strong(s, s | stateWaiters, std::memory_order_acq_rel)) {
+                    return (s & stateReady) != 0;
+                }
+                s |= stateWaiters;
+            }
+            _AMParker::wait(m_state, s, timeout);
+            return isReady();
+        }
+
+        std::atomic<uint32_t> m_state;
+        std::atomic<uint32_t> m_refs;
+        bool m_deferred;
+        _AMStateListener *m_listener;
+        std::exception_ptr m_exception;
+        int32_t m_watchSlot;
+    };
+
+    inline void _AMStateBase::wait() {
+        runDeferred();
+        if (isReady()) {
+            return;
+        }
+        int64_t start = _AMIdle::now();
+        if (!spin(INT64_MAX)) {
+            while (!park(nullptr)) {
+            }
+        }
+        _AMIdle::waiters().record(_AMIdle::now() - start);
+    }
+
+    template<class Clock, class Duration>
+    bool _AMStateBase::waitUntil(const std::chrono::time_point<Clock, Duration> &timeout_time) {
+        if (isReady()) {
+            return true;
+        }
+        int64_t start = _AMIdle::now();
+        auto left = timeout_time - Clock::now();
+        if (left <= decltype(left)::zero()) {
+            return isReady();
+        }
+        int64_t leftNs = std::chrono::duration_cast<std::chrono::nanoseconds>(left).count();
+        if (spin(leftNs < INT64_MAX - start ? start + leftNs : INT64_MAX)) {
+            _AMIdle::waiters().record(_AMIdle::now() - start);
+            return true;
+        }
+        for (;;) {
+            auto now = Clock::now();
+            if (now >= timeout_time) {
+                return isReady();
+            }
+            std::chrono::nanoseconds rest = std::chrono::duration_cast<std::chrono::nanoseconds>(timeout_time - now);
+            if (park(&rest)) {
+                _AMIdle::waiters().record(_AMIdle::now() - start);
+                return true;
+            }
+        }
+    }
+
+    /**
+     * \brief Shared state, that hands over result of type T.
+     */
+    template<class T>
+    class _AMSharedState : public _AMStateBase {
+    public:
+        /**
+         * \brief Hands over the result. Called once, after the state is ready.
+         */
+        virtual T take() = 0;
+    };
+
+    /**
+     * \brief Shared state with result of type T stored inline.
+     */
+    template<class T>
+    class _AMValueState : public _AMSharedState<T> {
+    public:
+        /**
+         * \brief Stores result of produce() or its exception and wakes waiters.
+         */
+        template<class Produce>
+        void fulfil(Produce &&produce) noexcept {
+            try {
+                m_value.emplace(std::invoke(std::forward<Produce>(produce)));
+            } catch (...) {
+                this->m_exception = std::current_exception();
+            }
+            this->complete();
+        }
+
+        T take() override {
+            if (this->m_exception) {
+                std::rethrow_exception(this->m_exception);
+            }
+            return std::move(*m_value);
+        }
+
+    protected:
+        std::optional<T> m_value;
+    };
+
+    template<class T>
+    class _AMValueState<T &> : public _AMSharedState<T &> {
+    public:
+        template<class Produce>
+        void fulfil(Produce &&produce) noexcept {
+            try {
+                m_value = &std::invoke(std::forward<Produce>(produce));
+            } catch (...) {
+                this->m_exception = std::current_exception();
+            }
+            this->complete();
+        }
+
+        T &take() override {
+            if (this->m_exception) {
+                std::rethrow_exception(this->m_exception);
+            }
+            return *m_value;
+        }
+
+    protected:
+        T *m_value = nullptr;
+    };
+
+    template<>
+    class _AMValueState<void> : public _AMSharedState<void> {
+    public:
+        template<class Produce>
+        void fulfil(Produce &&produce) noexcept {
+            try {
+                std::invoke(std::forward<Produce>(produce));
+            } catch (...) {
+                m_exception = std::current_exception();
+            }
+            complete();
+        }
+
+        void take() override {
+            if (m_exception) {
+                std::rethrow_exception(m_exception);
+            }
+        }
+    };
+
+    class AMWaitSet;
+    class AMTaskGraph;
+    class AMTimerWheel;
+    class _AMExecutorLaunch;
+    class AMFileIO;
+    class _AMHedgedLaunch;
+    class AMBatch;
+    template<class T>
+    class AMStream;
+    template<class T>
+    class AMPromise;
+
+}
+
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+
+namespace AMCore {
+
     template<class T>
     class AMFuture;
     template<class Callback, class AvailCallback, class Function, class TCF, class... Args>
     AMFuture<std::invoke_result_t<std::decay_t<Callback>, TCF, void *>>
-    AMAsync(AMLaunch policy, Callback &&callback, AvailCallback &&a, Function &&f, TCF &&tcf, Args &&... args);
+    AMAsync(_AMAt<AMLaunch> policy, Callback &&callback, AvailCallback &&a, Function &&f, TCF &&tcf, Args &&... args);
 
-    template<class Result>
-    class _AMLaunchFnHolderBase
-    {
+    template<class Result, class AvailCallback, class Callback, class TObject, class Function, class... Args>
+    class _AMLaunchFnHolder: public _AMSharedState<Result> {
     public:
-        _AMLaunchFnHolderBase(Result (*_sget)(void*, void*), bool (*_savail)(void*, void*), void* _holder)
-            :sget(_sget),
-            savail(_savail),
-            holder(_holder)
+        template<class... U>
+        _AMLaunchFnHolder(TObject& _obj, AvailCallback&& _ac, Callback&& _c, Function&& _f, U&&... _args)
+            : obj(_obj), ac(std::move(_ac)), c(std::move(_c)), f(std::move(_f)), args(std::forward<U>(_args)...), mem(nullptr)
         {
+            this->defer();
         }
-        Result SGet(void* mem)
+        ~_AMLaunchFnHolder()
         {
-            return sget(holder, mem);
         }
-        bool SIsAvail(void* mem)
+        void run() noexcept override
         {
-            return savail(holder, mem);
+            try {
+                mem = std::apply([this](Args&... a) { return std::invoke(f, obj, a...); }, args);
+            } catch (...) {
+                this->m_exception = std::current_exception();
+                this->complete();
+            }
         }
-        virtual ~_AMLaunchFnHolderBase()
+        bool poll() override
         {
+            if (this->isReady()) {
+                return true;
+            }
+            if (!this->isDeferred() && std::invoke(ac, obj, mem)) {
+                this->complete();
+                return true;
+            }
+            return false;
+        }
+        Result take() override
+        {
+            if (this->m_exception) {
+                std::rethrow_exception(this->m_exception);
+            }
+            return std::invoke(c, obj, mem);
+        }
+    protected:
+        TObject &obj;
+        AvailCallback ac;
+        Callback c;
+        Function f;
+        std::tuple<Args...> args;
+        void* mem;
+    };
 
+    /**
+     * \brief Queue of AMAsync calls, that have not run yet. It is emptied by AMPump().
+     */
+    class _AMRunQueue
+    {
+    public:
+        static void push(_AMStateBase* state)
+        {
+            state->addRef();
+            queue().push_back(state);
+        }
+        static bool runOne()
+        {
+            std::deque<_AMStateBase*>& m_queue = queue();
+            while (!m_queue.empty()) {
+                _AMStateBase* state = m_queue.front();
+                m_queue.pop_front();
+                // get() may have run the call already
+                bool deferred = state->isDeferred();
+                state->runDeferred();
+                state->release();
+                if (deferred) {
+                    return true;
+                }
+            }
+            return false;
+        }
+        static bool empty()
+        {
+            return queue().empty();
+        }
+        static std::size_t size()
+        {
+            return queue().size();
         }
     protected:
-        Result (*sget)(void* holder, void* mem);
-        bool (*savail)(void* holder, void* mem);
-        void* holder;
+        static std::deque<_AMStateBase*>& queue()
+        {
+            static std::deque<_AMStateBase*> m_queue;
+            return m_queue;
+        }
     };
 
-    template<class AvailCallback, class Callback, class TObject>
-    class _AMLaunchFnHolder: public _AMLaunchFnHolderBase<std::invoke_result_t<std::decay_t<Callback>, TObject, void*>> {
+    class _AMFutureZombieBase
+    {
     public:
-        _AMLaunchFnHolder(TObject& _obj, AvailCallback&& _ac, Callback&& _c)
-            : _AMLaunchFnHolderBase<std::invoke_result_t<std::decay_t<Callback>, TObject, void*>>(_AMLaunchFnHolder::SGetS, _AMLaunchFnHolder::SIsAvailS,(void*)this), obj(_obj), ac(std::move(_ac)), c(std::move(_c))
+        static void add(_AMStateBase* p)
         {
+            p->addRef();
+            zombies().insert(p);
         }
-        ~_AMLaunchFnHolder()
+        static bool checkZombies()
         {
+            return reap(SIZE_MAX, nullptr) == 0;
+        }
+        static std::size_t checkZombies(std::size_t maxItems)
+        {
+            return reap(maxItems, nullptr);
+        }
+        static std::size_t checkZombies(std::chrono::steady_clock::time_point deadline)
+        {
+            return reap(SIZE_MAX, &deadline);
         }
     protected:
-        static bool SIsAvailS(void* _holder, void* mem)
+        static std::size_t reap(std::size_t maxItems, const std::chrono::steady_clock::time_point* deadline)
         {
-            _AMLaunchFnHolder* holder = (_AMLaunchFnHolder*)_holder;
-            return std::invoke(holder->ac, holder->obj, mem);
+            std::set<_AMStateBase*>& m_zombies = zombies();
+            _AMStateBase*& m_cursor = cursor();
+            std::size_t count = std::min(maxItems, m_zombies.size());
+            std::set<_AMStateBase*>::iterator it = m_zombies.upper_bound(m_cursor);
+            for (std::size_t n = 0; n < count; ++n) {
+                if (it == m_zombies.end()) {
+                    it = m_zombies.begin();
+                }
+                m_cursor = *it;
+                // zombie, whose call is still queued, would never become ready without AMPump()
+                (*it)->runDeferred();
+                if ((*it)->poll()) {
+                    (*it)->release();
+                    it = m_zombies.erase(it);
+                } else {
+                    ++it;
+                }
+                if (deadline && std::chrono::steady_clock::now() >= *deadline) {
+                    break;
+                }
+            }
+            return m_zombies.size();
         }
-        static std::invoke_result_t<std::decay_t<Callback>, TObject, void*> SGetS(void* _holder, void* mem)
+        static std::set<_AMStateBase*>& zombies()
         {
-            _AMLaunchFnHolder* holder = (_AMLaunchFnHolder*)_holder;
-            return std::invoke(holder->c, holder->obj, mem);
+            static std::set<_AMStateBase*> m_zombies;
+            return m_zombies;
+        }
+        static _AMStateBase*& cursor()
+        {
+            static _AMStateBase* m_cursor = nullptr;
+            return m_cursor;
         }
-        TObject &obj;
-        AvailCallback ac;
-        Callback c;
     };
 
     template<class T> class AMFuture
@@ -115,48 +997,51 @@ namespace AMCore {
         template<class Callback, class AvailCallback, class Function, class TCF, class... Args>
         friend
         AMFuture<std::invoke_result_t<std::decay_t<Callback>, TCF, void *>>
-        AMAsync(AMLaunch policy, Callback &&callback, AvailCallback &&a, Function &&f, TCF &&tcf, Args &&... args);
+        AMAsync(_AMAt<AMLaunch> policy, Callback &&callback, AvailCallback &&a, Function &&f, TCF &&tcf, Args &&... args);
+
+        friend class AMWaitSet;
+        friend class AMTaskGraph;
+        friend class AMTimerWheel;
+        friend class _AMExecutorLaunch;
+        friend class AMFileIO;
+        friend class _AMHedgedLaunch;
+        friend class AMBatch;
+        template<class U> friend class AMStream;
+        template<class U> friend class AMPromise;
 
     protected:
         template< class Callback, class AvailCallback, class Function, class TCF, class... Args > friend
         AMFuture<std::invoke_result_t<std::decay_t<Callback>, TCF, void*>>
-        AMAsync( AMLaunch policy, Callback&& callback, AvailCallback&& a, Function&& f, TCF&& tcf, Args&&... args );
+        AMAsync( _AMAt<AMLaunch> policy, Callback&& callback, AvailCallback&& a, Function&& f, TCF&& tcf, Args&&... args );
 
         void destroy();
-        bool validFlag;
-        void *mem;
-        _AMLaunchFnHolderBase<T>* holder;
-        AMFuture(void*, _AMLaunchFnHolderBase<T>* holder) noexcept;
+        _AMSharedState<T>* m_state;
+        AMFuture(_AMSharedState<T>* state) noexcept;
     };
 
     template<class T> AMFuture<T>::AMFuture() noexcept:
-        validFlag(false), mem(), holder(nullptr)
+        m_state(nullptr)
     {
     }
 
     template<class T> AMFuture<T>::AMFuture(AMFuture&& other) noexcept
     {
-        validFlag = other.validFlag;
-        other.validFlag = false;
-        mem = other.mem;
-        other.mem = nullptr;
-        holder = other.holder;
-        other.holder = nullptr;
+        m_state = other.m_state;
+        other.m_state = nullptr;
     }
 
     template<class T> AMFuture<T>& AMFuture<T>::operator=(AMFuture&& other) noexcept
     {
-        validFlag = other.validFlag;
-        other.validFlag = false;
-        mem = other.mem;
-        other.mem = nullptr;
-        holder = other.holder;
-        other.holder = nullptr;
+        if (this != &other) {
+            destroy();
+            m_state = other.m_state;
+            other.m_state = nullptr;
+        }
         return *this;
     }
 
-    template<class T> AMFuture<T>::AMFuture(void* _mem, _AMLaunchFnHolderBase<T>* _holder) noexcept:
-        validFlag(false), mem(_mem), holder(_holder)
+    template<class T> AMFuture<T>::AMFuture(_AMSharedState<T>* state) noexcept:
+        m_state(state)
     {
     }
 
@@ -167,7 +1052,7 @@ namespace AMCore {
 
     template<class T> bool AMFuture<T>::valid() const noexcept
     {
-        if (validFlag || (holder && holder->SIsAvail(mem))) {
+        if (m_state && m_state->poll()) {
             return true;
         }
         return false;
@@ -175,13 +1060,16 @@ namespace AMCore {
     template<class T> T AMFuture<T>::get()
     {
         wait();
-        validFlag = false;
-        T rv = holder->SGet(mem);
-        if (holder) {
-            delete holder;
-            holder = nullptr;
+        _AMSharedState<T>* state = m_state;
+        m_state = nullptr;
+        struct Release {
+            _AMSharedState<T>* state;
+            ~Release() { state->release(); }
+        } release{state};
+        if (state->isExpired()) {
+            throw AMFutureTimeout();
         }
-        return rv;
+        return state->take();
     }
     /*
     template<class T> T& AMFuture<T>::get()
@@ -198,19 +1086,21 @@ namespace AMCore {
     */
     template<class T> void AMFuture<T>::destroy()
     {
-        wait();
-        if (holder) {
-            delete holder;
-            holder = nullptr;
+        if (m_state) {
+            if (!m_state->poll()) {
+                m_state->watchZombie();
+                _AMFutureZombieBase::add(m_state);
+            }
+            m_state->release();
+            m_state = nullptr;
         }
     }
 
     template<class T> void AMFuture<T>::wait() const
     {
-        if (!validFlag) {
-            if (holder) {
-                assert(holder->SIsAvail(mem));
-            }
+        if (m_state) {
+            m_state->runDeferred();
+            assert(m_state->poll());
         }
     }
 
@@ -218,10 +1108,19 @@ namespace AMCore {
     template< class Rep, class Period >
     AMFutureStatus AMFuture<T>::wait_for( const std::chrono::duration<Rep,Period>& timeout_duration ) const
     {
-        if (validFlag || (holder && holder->SIsAvail(mem))) {
-            return AMFutureStatus::ready;
+        if (!m_state) {
+            return AMFutureStatus::timeout;
         }
-        return AMFutureStatus::timeout;
+        auto deadline = std::chrono::steady_clock::now() + timeout_duration;
+        m_state->runDeferred();
+        // nobody else can make progress, so run queued calls, while waiting
+        while (!m_state->poll()) {
+            if (std::chrono::steady_clock::now() >= deadline) {
+                return AMFutureStatus::timeout;
+            }
+            _AMRunQueue::runOne();
+        }
+        return AMFutureStatus::ready;
     }
 
     template< class Function, class... Args >
@@ -233,57 +1132,123 @@ namespace AMCore {
 
     template< class Callback, class AvailCallback, class Function, class TCF, class... Args >
     AMFuture<std::invoke_result_t<std::decay_t<Callback>, TCF, void*>>
-    AMAsync( AMLaunch policy, Callback&& callback, AvailCallback&& a, Function&& f, TCF&& tcf, Args&&... args )
+    AMAsync( _AMAt<AMLaunch> policy, Callback&& callback, AvailCallback&& a, Function&& f, TCF&& tcf, Args&&... args )
     {
-        (void)policy;
-        auto h = new _AMLaunchFnHolder(tcf, std::move(a), std::move(callback));
-        void* mem = std::invoke(f, tcf, args...);
-        return AMFuture<std::invoke_result_t<std::decay_t<Callback>, std::decay_t<TCF>, void*>>(mem, h);
+        typedef std::invoke_result_t<std::decay_t<Callback>, std::decay_t<TCF>, void*> T;
+        auto h = new _AMLaunchFnHolder<T, std::decay_t<AvailCallback>, std::decay_t<Callback>, std::remove_reference_t<TCF>, std::decay_t<Function>, std::decay_t<Args>...>(
+            tcf, std::move(a), std::move(callback), std::move(f), std::forward<Args>(args)...);
+        h->watch(policy.site);
+        _AMRunQueue::push(h);
+        return AMFuture<T>(h);
     }
 
 
 
-    class _AMFutureZombieBase
-    {
-    public:
-        static bool checkZombies() {return true;};
-    };
-
     inline bool checkZombies()
     {
         return _AMFutureZombieBase::checkZombies();
     }
 
+    inline std::size_t checkZombies(std::size_t maxItems)
+    {
+        return _AMFutureZombieBase::checkZombies(maxItems);
+    }
+
+    inline std::size_t checkZombies(std::chrono::steady_clock::time_point deadline)
+    {
+        return _AMFutureZombieBase::checkZombies(deadline);
+    }
+
+    /**
+     * \brief Runs queued AMAsync calls and releases finished futures, until budget is spent.
+     *
+     * Call it once per frame. At least one queued call is run, so the queue always makes progress.
+     * @param budget time, that can be spent
+     * @return true, if there is nothing left to do
+     */
+    inline bool AMPump(std::chrono::microseconds budget)
+    {
+        auto deadline = std::chrono::steady_clock::now() + budget;
+        while (_AMRunQueue::runOne()) {
+            if (std::chrono::steady_clock::now() >= deadline) {
+                return false;
+            }
+        }
+        return checkZombies(deadline) == 0;
+    }
+
 }
 #else
 
-#include <future>
-#include <set>
-
 namespace AMCore {
 
     /**
-     * \brief Status of future is exacly the same as std::future_status
+     * \brief Shared state, that owns the launched call prepareData() and getData().
      */
-    typedef std::future_status AMFutureStatus;
+    template<class T, class Function, class Callback, class TCF, class... Args>
+    class _AMTaskState : public _AMValueState<T> {
+    public:
+        template<class... U>
+        _AMTaskState(U &&... u)
+            : m_bound(std::forward<U>(u)...) {
+        }
+
+        void run() noexcept override {
+            this->fulfil([this]() -> T {
+                return std::apply(_AMTaskState::perform, m_bound);
+            });
+        }
+
+    protected:
+        static T perform(Function &f, Callback &c, TCF &tcf, Args &... args) {
+            void *mem = std::invoke(f, tcf, args...);
+            return std::invoke(c, tcf, mem);
+        }
+
+        std::tuple<Function, Callback, TCF, Args...> m_bound;
+    };
 
     /**
-     * \brief Launch mode is exactly the same as std::launch
+     * \brief Starts task of new shared state on its own thread, or defers it to the first waiter.
+     *
+     * The thread holds its own reference. If the thread cannot be started, the reference of the caller is released
+     * too and the exception is rethrown.
+     * @param state shared state, whose run() is the task
+     * @param policy AMLaunch::async starts thread, otherwise the state is deferred
      */
-    typedef std::launch AMLaunch;
-
+    inline void _AMLaunchThread(_AMStateBase *state, AMLaunch policy) {
+        if ((policy & AMLaunch::async) != AMLaunch::async) {
+            state->defer();
+            return;
+        }
+        state->addRef();
+        try {
+            std::thread([state]() {
+                state->run();
+                state->release();
+            }).detach();
+        } catch (...) {
+            state->release();
+            state->release();
+            throw;
+        }
+    }
 
     template<class T>
     class AMFuture;
+    template<class T>
+    class AMSharedFuture;
     template<class Callback, class AvailCallback, class Function, class TCF, class... Args>
     AMFuture<std::invoke_result_t<std::decay_t<Callback>, TCF, void *>>
-    AMAsync(AMLaunch policy, Callback &&callback, AvailCallback &&a, Function &&f, TCF &&tcf, Args &&... args);
+    AMAsync(_AMAt<AMLaunch> policy, Callback &&callback, AvailCallback &&a, Function &&f, TCF &&tcf, Args &&... args);
 
     /**
      * \brief Result of type T of asynchronous call.
+     *
+     * Holds only a pointer to the shared state. Shared state is one atomic word and inline result.
      */
     template<class T>
-    class AMFuture : public std::future<T> {
+    class AMFuture {
     public:
 
         /**
@@ -322,48 +1287,133 @@ namespace AMCore {
          */
         ~AMFuture();
 
+        /**
+         * \brief Checks if the future refers to a shared state
+         * @return true, if get() can be called
+         */
+        bool valid() const noexcept;
+
+        /**
+         * \brief Waits for result and returns it. After the call valid() is false.
+         * @return result of getData()
+         */
+        T get();
+
+        /**
+         * \brief Waits for result.
+         */
+        void wait() const;
+
+        /**
+         * \brief Waits for result at most timeout_duration.
+         * @param timeout_duration maximal time to wait
+         * @return AMFutureStatus::ready, AMFutureStatus::timeout or AMFutureStatus::deferred
+         */
+        template<class Rep, class Period>
+        AMFutureStatus wait_for(const std::chrono::duration<Rep, Period> &timeout_duration) const;
+
+        /**
+         * \brief Waits for result until timeout_time.
+         * @param timeout_time time, when to stop waiting
+         * @return AMFutureStatus::ready, AMFutureStatus::timeout or AMFutureStatus::deferred
+         */
+        template<class Clock, class Duration>
+        AMFutureStatus wait_until(const std::chrono::time_point<Clock, Duration> &timeout_time) const;
+
+        /**
+         * \brief Moves the shared state to \ref AMSharedFuture, that can be copied. After the call valid() is false.
+         * @return AMSharedFuture<T>
+         */
+        AMSharedFuture<T> share() noexcept;
+
         template<class Callback, class AvailCallback, class Function, class TCF, class... Args>
         friend
         AMFuture<std::invoke_result_t<std::decay_t<Callback>, TCF, void *>>
-        AMAsync(AMLaunch policy, Callback &&callback, AvailCallback &&a, Function &&f, TCF &&tcf, Args &&... args);
+        AMAsync(_AMAt<AMLaunch> policy, Callback &&callback, AvailCallback &&a, Function &&f, TCF &&tcf, Args &&... args);
+
+        friend class AMWaitSet;
+        friend class AMTaskGraph;
+        friend class AMTimerWheel;
+        friend class _AMExecutorLaunch;
+        friend class AMFileIO;
+        friend class _AMHedgedLaunch;
+        friend class AMBatch;
+        template<class U> friend class AMStream;
+        template<class U> friend class AMPromise;
+        template<class U> friend class AMSharedFuture;
     protected:
         template<class Callback, class AvailCallback, class Function, class TCF, class... Args>
         friend
         AMFuture<std::invoke_result_t<std::decay_t<Callback>, TCF, void *>>
-        AMAsync(AMLaunch policy, Callback &&callback, AvailCallback &&a, Function &&f, TCF &&tcf, Args &&... args);
+        AMAsync(_AMAt<AMLaunch> policy, Callback &&callback, AvailCallback &&a, Function &&f, TCF &&tcf, Args &&... args);
+
+        AMFuture(_AMSharedState<T> *state) noexcept;
+
+        void checkState() const;
+
+        _AMSharedState<T> *m_state;
+    };
+
+    template<class T>
+    AMFuture<T>::AMFuture() noexcept
+        :m_state(nullptr) {
+    }
+
+    template<class T>
+    AMFuture<T>::AMFuture(AMFuture<T> &&other) noexcept
+        :m_state(other.m_state) {
+        other.m_state = nullptr;
+    }
 
-        template<class Function, class Callback, class TCF, class... Args>
-        static T perform(Function &&f, Callback &&c, TCF &&tcf, Args &&... args);
+    template<class T>
+    AMFuture<T>::AMFuture(_AMSharedState<T> *state) noexcept
+        :m_state(state) {
+    }
 
-        AMFuture(std::future<T> &&other) noexcept;
-    };
+    template<class T>
+    AMFuture<T> &AMFuture<T>::operator=(AMFuture &&other) noexcept {
+        if (this != &other) {
+            if (m_state) {
+                AMFuture<T> old(std::move(*this));
+            }
+            m_state = other.m_state;
+            other.m_state = nullptr;
+        }
+        return *this;
+    }
 
     template<class T>
-    AMFuture<T>::AMFuture() noexcept
-        :std::future<T>() {
+    bool AMFuture<T>::valid() const noexcept {
+        return m_state != nullptr;
     }
 
     template<class T>
-    AMFuture<T>::AMFuture(AMFuture<T> &&other) noexcept
-        :std::future<T>(std::move(other)) {
+    void AMFuture<T>::checkState() const {
+        if (!m_state) {
+            throw std::future_error(std::future_errc::no_state);
+        }
     }
 
     template<class T>
-    AMFuture<T>::AMFuture(std::future<T> &&other) noexcept
-        :std::future<T>(std::move(other)) {
+    void AMFuture<T>::wait() const {
+        checkState();
+        m_state->wait();
     }
 
     template<class T>
-    AMFuture<T> &AMFuture<T>::operator=(AMFuture &&other) noexcept {
-        std::future<T>::operator=(std::move(other));
-        return *this;
+    template<class Rep, class Period>
+    AMFutureStatus AMFuture<T>::wait_for(const std::chrono::duration<Rep, Period> &timeout_duration) const {
+        return wait_until(std::chrono::steady_clock::now() + timeout_duration);
     }
 
     template<class T>
-    template<class Function, class Callback, class TCF, class... Args>
-    T AMFuture<T>::perform(Function &&f, Callback &&c, TCF &&tcf, Args &&... args) {
-        void *mem = std::invoke(f, tcf, args...);
-        return std::invoke(c, tcf, mem);
+    template<class Clock, class Duration>
+    AMFutureStatus AMFuture<T>::wait_until(const std::chrono::time_point<Clock, Duration> &timeout_time) const {
+        checkState();
+        if (m_state->isDeferred()) {
+            return AMFutureStatus::deferred;
+        }
+        return m_state->waitUntil(timeout_time) ? AMFutureStatus::ready : AMFutureStatus::timeout;
     }
 
     /**
@@ -386,20 +1436,19 @@ namespace AMCore {
      */
     template<class Callback, class AvailCallback, class Function, class TCF, class... Args>
     AMFuture<std::invoke_result_t<std::decay_t<Callback>, TCF, void *>>
-    AMAsync(AMLaunch policy, Callback &&callback, AvailCallback &&a, Function &&f, TCF &&tcf, Args &&... args) {
-        (void) policy;
-        auto newCallback = &AMFuture<std::invoke_result_t<std::decay_t<Callback>, std::decay_t<TCF>, void *>>::template perform<std::decay_t<Function>, std::decay_t<Callback>, std::decay_t<TCF>, std::decay_t<Args>...>;
-        std::future<std::invoke_result_t<std::decay_t<Callback>, TCF, void *>> base =
-            std::async(
-                policy,
-                newCallback,
-                std::forward<Function>(f),
-                std::forward<Callback>(callback),
-                std::forward<TCF>(tcf),
-                std::forward<Args>(args)...
-                );
-        return std::move(
-            AMFuture<std::invoke_result_t<std::decay_t<Callback>, std::decay_t<TCF>, void *>>(std::move(base)));
+    AMAsync(_AMAt<AMLaunch> policy, Callback &&callback, AvailCallback &&a, Function &&f, TCF &&tcf, Args &&... args) {
+        (void) a;
+        typedef std::invoke_result_t<std::decay_t<Callback>, TCF, void *> T;
+        typedef _AMTaskState<T, std::decay_t<Function>, std::decay_t<Callback>, std::decay_t<TCF>, std::decay_t<Args>...> State;
+        State *state = new State(
+            std::forward<Function>(f),
+            std::forward<Callback>(callback),
+            std::forward<TCF>(tcf),
+            std::forward<Args>(args)...
+            );
+        state->watch(policy.site);
+        _AMLaunchThread(state, policy.value);
+        return AMFuture<T>(state);
     }
 
     class _AMFutureZombieBase {
@@ -408,6 +1457,10 @@ namespace AMCore {
 
         static bool checkZombies();
 
+        static std::size_t checkZombies(std::size_t maxItems);
+
+        static std::size_t checkZombies(std::chrono::steady_clock::time_point deadline);
+
         virtual ~_AMFutureZombieBase();
 
     protected:
@@ -417,7 +1470,11 @@ namespace AMCore {
 
         virtual void get() = 0;
 
+        static std::size_t reap(std::size_t maxItems, const std::chrono::steady_clock::time_point *deadline);
+
         static std::set<_AMFutureZombieBase *> m_zombies;
+        static _AMFutureZombieBase *m_cursor;
+        static std::mutex m_mutex;
     };
 
     template<class T>
@@ -435,9 +1492,26 @@ namespace AMCore {
 
     template<class T>
     AMFuture<T>::~AMFuture() {
-        if (AMFuture<T>::valid()) {
-            _AMFutureZombieBase::add(new _AMFutureZombie<T>(std::move(*this)));
+        if (m_state) {
+            if (m_state->isSettled() || m_state->isDeferred()) {
+                m_state->release();
+            } else {
+                m_state->watchZombie();
+                _AMFutureZombieBase::add(new _AMFutureZombie<T>(std::move(*this)));
+            }
+        }
+    }
+
+    template<class T>
+    T AMFuture<T>::get() {
+        checkState();
+        m_state->wait();
+        // destructor of the moved future keeps the state as zombie, while its producer still runs
+        AMFuture<T> done(std::move(*this));
+        if (done.m_state->isExpired()) {
+            throw AMFutureTimeout();
         }
+        return done.m_state->take();
     }
 
     template<class T>
@@ -447,12 +1521,13 @@ namespace AMCore {
 
     template<class T>
     bool _AMFutureZombie<T>::ready() {
-        return AMFuture<T>::wait_for(std::chrono::seconds(0)) == AMCore::AMFutureStatus::ready;
+        return AMFuture<T>::m_state->isSettled();
     }
 
     template<class T>
     void _AMFutureZombie<T>::get() {
-        AMFuture<T>::get();
+        AMFuture<T>::m_state->release();
+        AMFuture<T>::m_state = nullptr;
     }
 
     template<class T>
@@ -460,6 +1535,217 @@ namespace AMCore {
         :AMFuture<T>(std::move(other)) {
     }
 
+    /**
+     * \brief Result kept by \ref AMSharedFuture, after it was taken from the shared state.
+     */
+    template<class T>
+    class _AMSharedResult {
+    public:
+        typedef const T &Ref;
+
+        void store(AMFuture<T> &future) {
+            m_value.emplace(future.get());
+        }
+
+        Ref get() const noexcept {
+            return *m_value;
+        }
+
+    protected:
+        std::optional<T> m_value;
+    };
+
+    template<class T>
+    class _AMSharedResult<T &> {
+    public:
+        typedef T &Ref;
+
+        void store(AMFuture<T &> &future) {
+            m_value = &future.get();
+        }
+
+        Ref get() const noexcept {
+            return *m_value;
+        }
+
+    protected:
+        T *m_value = nullptr;
+    };
+
+    template<>
+    class _AMSharedResult<void> {
+    public:
+        typedef void Ref;
+
+        void store(AMFuture<void> &future) {
+            future.get();
+        }
+
+        Ref get() const noexcept {
+        }
+    };
+
+    /**
+     * \brief Result of asynchronous call, that can be read by more owners, like std::shared_future.
+     *
+     * Copies share one counted holder. The first get() or wait() takes the result from the shared state, the
+     * others read the kept copy. Deferred call runs once, in the first get() or wait().
+     */
+    template<class T>
+    class AMSharedFuture {
+    public:
+        /**
+         * \brief default contructor
+         */
+        AMSharedFuture() noexcept
+            : m_shared(nullptr) {
+        }
+
+        /**
+         * \brief Takes the shared state of future. future.valid() is false after the call.
+         * @param future source future
+         */
+        AMSharedFuture(AMFuture<T> &&future) noexcept
+            : m_shared(future.valid() ? new Shared(std::move(future)) : nullptr) {
+        }
+
+        AMSharedFuture(const AMSharedFuture &other) noexcept
+            : m_shared(other.m_shared) {
+            if (m_shared) {
+                m_shared->refs.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        AMSharedFuture(AMSharedFuture &&other) noexcept
+            : m_shared(other.m_shared) {
+            other.m_shared = nullptr;
+        }
+
+        AMSharedFuture &operator=(const AMSharedFuture &other) noexcept {
+            AMSharedFuture copy(other);
+            std::swap(m_shared, copy.m_shared);
+            return *this;
+        }
+
+        AMSharedFuture &operator=(AMSharedFuture &&other) noexcept {
+            AMSharedFuture old(std::move(*this));
+            std::swap(m_shared, other.m_shared);
+            return *this;
+        }
+
+        /**
+         * \brief destructor. The last copy releases the shared state, or leaves it as zombie.
+         */
+        ~AMSharedFuture() {
+            if (m_shared && m_shared->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                delete m_shared;
+            }
+        }
+
+        /**
+         * \brief Checks if the future refers to a shared state
+         * @return true, if get() can be called
+         */
+        bool valid() const noexcept {
+            return m_shared != nullptr;
+        }
+
+        /**
+         * \brief Waits for result and returns it. It can be called more times and from more threads.
+         * @return result of getData(), const reference for values
+         */
+        typename _AMSharedResult<T>::Ref get() const {
+            take();
+            if (m_shared->exception) {
+                std::rethrow_exception(m_shared->exception);
+            }
+            return m_shared->result.get();
+        }
+
+        /**
+         * \brief Waits for result.
+         */
+        void wait() const {
+            take();
+        }
+
+        /**
+         * \brief Waits for result at most timeout_duration.
+         * @param timeout_duration maximal time to wait
+         * @return AMFutureStatus::ready, AMFutureStatus::timeout or AMFutureStatus::deferred
+         */
+        template<class Rep, class Period>
+        AMFutureStatus wait_for(const std::chrono::duration<Rep, Period> &timeout_duration) const {
+            return wait_until(std::chrono::steady_clock::now() + timeout_duration);
+        }
+
+        /**
+         * \brief Waits for result until timeout_time.
+         * @param timeout_time time, when to stop waiting
+         * @return AMFutureStatus::ready, AMFutureStatus::timeout or AMFutureStatus::deferred
+         */
+        template<class Clock, class Duration>
+        AMFutureStatus wait_until(const std::chrono::time_point<Clock, Duration> &timeout_time) const {
+            checkState();
+            if (m_shared->taken.load(std::memory_order_acquire)) {
+                return AMFutureStatus::ready;
+            }
+            if (m_shared->deferred) {
+                return AMFutureStatus::deferred;
+            }
+            return m_shared->state->waitUntil(timeout_time) ? AMFutureStatus::ready : AMFutureStatus::timeout;
+        }
+
+    protected:
+        class Shared {
+        public:
+            explicit Shared(AMFuture<T> &&other) noexcept
+                : refs(1), state(other.m_state), deferred(other.m_state->isDeferred()), taken(false),
+                  future(std::move(other)) {
+                state->addRef();
+            }
+
+            ~Shared() {
+                state->release();
+            }
+
+            std::atomic<std::size_t> refs;
+            _AMSharedState<T> *state;
+            const bool deferred;
+            std::atomic<bool> taken;
+            AMFuture<T> future;
+            std::once_flag once;
+            std::exception_ptr exception;
+            _AMSharedResult<T> result;
+        };
+
+        void checkState() const {
+            if (!m_shared) {
+                throw std::future_error(std::future_errc::no_state);
+            }
+        }
+
+        void take() const {
+            checkState();
+            Shared *shared = m_shared;
+            std::call_once(shared->once, [shared]() {
+                try {
+                    shared->result.store(shared->future);
+                } catch (...) {
+                    shared->exception = std::current_exception();
+                }
+                shared->taken.store(true, std::memory_order_release);
+            });
+        }
+
+        Shared *m_shared;
+    };
+
+    template<class T>
+    AMSharedFuture<T> AMFuture<T>::share() noexcept {
+        return AMSharedFuture<T>(std::move(*this));
+    }
+
 
     /**
      * \brief Check for active \ref AMFuture
@@ -469,8 +1755,369 @@ namespace AMCore {
     {
         return _AMFutureZombieBase::checkZombies();
     }
+
+    /**
+     * \brief Checks at most maxItems active \ref AMFuture. Next call continues, where this one stopped.
+     * @param maxItems maximal number of checked futures
+     * @return number of futures, that are still active
+     */
+    inline std::size_t checkZombies(std::size_t maxItems)
+    {
+        return _AMFutureZombieBase::checkZombies(maxItems);
+    }
+
+    /**
+     * \brief Checks active \ref AMFuture until deadline. Next call continues, where this one stopped.
+     * @param deadline time, when to stop checking. At least one future is checked.
+     * @return number of futures, that are still active
+     */
+    inline std::size_t checkZombies(std::chrono::steady_clock::time_point deadline)
+    {
+        return _AMFutureZombieBase::checkZombies(deadline);
+    }
+
+    /**
+     * \brief Releases finished futures, until budget is spent. AMAsync calls run on their own threads, so there is no queue to run.
+     *
+     * Same source as for singlethreaded build, where it runs queued AMAsync calls.
+     * @param budget time, that can be spent
+     * @return true, if there is nothing left to do
+     */
+    inline bool AMPump(std::chrono::microseconds budget)
+    {
+        return checkZombies(std::chrono::steady_clock::now() + budget) == 0;
+    }
 }
 
 
 #endif
+
+namespace AMCore {
+
+    /**
+     * \brief Producer side of AMFuture.
+     *
+     * Data source calls set_value() once, when the result is ready. Futures do not ask any callback, they only check
+     * an atomic flag, and waiting threads and AMWaitSet are woken directly.
+     */
+    template<class T>
+    class AMPromise {
+    public:
+        /**
+         * \brief Creates new shared state.
+         */
+        AMPromise()
+            : m_state(new _AMValueState<T>()), m_retrieved(false), m_satisfied(false) {
+        }
+
+        AMPromise(AMPromise &&other) noexcept
+            : m_state(other.m_state), m_retrieved(other.m_retrieved), m_satisfied(other.m_satisfied) {
+            other.m_state = nullptr;
+        }
+
+        AMPromise(const AMPromise &other) = delete;
+
+        AMPromise &operator=(AMPromise &&other) noexcept {
+            if (this != &other) {
+                AMPromise old(std::move(*this));
+                m_state = other.m_state;
+                m_retrieved = other.m_retrieved;
+                m_satisfied = other.m_satisfied;
+                other.m_state = nullptr;
+            }
+            return *this;
+        }
+
+        AMPromise &operator=(const AMPromise &other) = delete;
+
+        /**
+         * \brief destructor. If no result was set, the future gets broken promise error.
+         */
+        ~AMPromise() {
+            if (m_state) {
+                if (!m_satisfied) {
+                    std::exception_ptr e = _AMBrokenPromise();
+                    m_state->fulfil([&]() -> T {
+                        std::rethrow_exception(e);
+                    });
+                }
+                m_state->release();
+            }
+        }
+
+        /**
+         * \brief Returns the future. Can be called only once.
+         */
+        AMFuture<T> get_future() {
+            assert(m_state);
+            if (m_retrieved) {
+                _AMFutureRetrieved();
+            }
+            m_retrieved = true;
+            m_state->addRef();
+            return AMFuture<T>(m_state);
+        }
+
+        /**
+         * \brief Stores the result and wakes the future.
+         * @param value constructor parameters of T, nothing for AMPromise<void>
+         */
+        template<class... U>
+        void set_value(U &&... value) {
+            satisfy();
+            m_state->fulfil([&]() -> T {
+                if constexpr (!std::is_void_v<T>) {
+                    return T(std::forward<U>(value)...);
+                }
+            });
+        }
+
+        /**
+         * \brief Stores the exception, that get() of the future throws.
+         */
+        void set_exception(std::exception_ptr e) {
+            satisfy();
+            m_state->fulfil([&]() -> T {
+                std::rethrow_exception(e);
+            });
+        }
+
+    protected:
+        void satisfy() {
+            assert(m_state);
+            if (m_satisfied) {
+                _AMPromiseSatisfied();
+            }
+            m_satisfied = true;
+        }
+
+        _AMValueState<T> *m_state;
+        bool m_retrieved;
+        bool m_satisfied;
+    };
+
+    /**
+     * \brief Set of futures, that can be waited for at once.
+     *
+     * Every registered future signals the set directly, when it becomes ready, so one call of wait_any() costs O(ready),
+     * not O(registered). Only one thread may wait on the set.
+     *
+     * In singlethreaded build, readiness of AMAsync results is known only by asking AvailCallback, so wait_any()
+     * asks each pending future once and never blocks.
+     */
+    class AMWaitSet {
+    public:
+        AMWaitSet() noexcept
+            : m_head(nullptr), m_signal(0), m_pending(0) {
+        }
+
+        AMWaitSet(const AMWaitSet &other) = delete;
+
+        AMWaitSet &operator=(const AMWaitSet &other) = delete;
+
+        /**
+         * \brief destructor. Registered futures stay untouched.
+         */
+        ~AMWaitSet() {
+            for (Entry &e: m_entries) {
+                if (e.attached) {
+                    e.state->detach();
+                }
+                e.state->release();
+            }
+        }
+
+        /**
+         * \brief Registers future. The future stays usable, the set only watches its shared state.
+         *
+         * Deferred future is reported ready immediately, because get() on it does not wait for anybody. In singlethreaded
+         * build, calls queued by AMAsync stay pending, waiting runs them and polls isDataAvail.
+         * A future can be registered in one set only.
+         * @param future valid future
+         * @return index of the future in the set
+         */
+        template<class T>
+        std::size_t add(const AMFuture<T> &future) {
+            _AMStateBase *state = future.m_state;
+            assert(state);
+            std::size_t index = m_entries.size();
+            m_entries.emplace_back(this, state, index);
+            Entry &e = m_entries.back();
+            state->addRef();
+            ++m_pending;
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+            bool listen = true;
+#else
+            bool listen = !state->isDeferred();
+#endif
+            if (listen && state->attach(&e)) {
+                e.attached = true;
+            } else {
+                push(&e);
+            }
+            return index;
+        }
+
+        /**
+         * \brief Number of registered futures.
+         */
+        std::size_t size() const noexcept {
+            return m_entries.size();
+        }
+
+        /**
+         * \brief Number of registered futures, that have not been reported ready yet.
+         */
+        std::size_t pending() const noexcept {
+            return m_pending;
+        }
+
+        /**
+         * \brief Waits, until at least one registered future is ready.
+         * @return indices of futures, that became ready since the last call. Each index is reported once. Empty, if nothing is pending.
+         */
+        const std::vector<std::size_t> &wait_any() {
+            m_ready.clear();
+            waitReady(nullptr);
+            return m_ready;
+        }
+
+        /**
+         * \brief Waits at most timeout_duration, until at least one registered future is ready.
+         * @param timeout_duration maximal time to wait
+         * @return indices of futures, that became ready since the last call. Empty on timeout.
+         */
+        template<class Rep, class Period>
+        const std::vector<std::size_t> &wait_any_for(const std::chrono::duration<Rep, Period> &timeout_duration) {
+            auto deadline = std::chrono::steady_clock::now() + timeout_duration;
+            m_ready.clear();
+            waitReady(&deadline);
+            return m_ready;
+        }
+
+        /**
+         * \brief Waits, until all registered futures are ready.
+         * @return indices of futures, that became ready since the last call.
+         */
+        const std::vector<std::size_t> &wait_all() {
+            m_ready.clear();
+            while (m_pending > 0) {
+                std::size_t before = m_ready.size();
+                waitReady(nullptr);
+                if (m_ready.size() == before) {
+                    break;
+                }
+            }
+            return m_ready;
+        }
+
+    protected:
+        class Entry : public _AMStateListener {
+        public:
+            Entry(AMWaitSet *_set, _AMStateBase *_state, std::size_t _index) noexcept
+                : set(_set), state(_state), index(_index), next(nullptr), attached(false), reported(false) {
+            }
+
+            void onReady() noexcept override {
+                set->push(this);
+            }
+
+            AMWaitSet *set;
+            _AMStateBase *state;
+            std::size_t index;
+            Entry *next;
+            bool attached;
+            bool reported;
+        };
+
+        void push(Entry *e) noexcept {
+            Entry *head = m_head.load(std::memory_order_relaxed);
+            do {
+                e->next = head;
+            } while (!m_head.compare_exchange_weak(head, e, std::memory_order_release, std::memory_order_relaxed));
+            if (m_signal.fetch_add(2, std::memory_order_release) & 1u) {
+                _AMParker::wakeAll(m_signal);
+            }
+        }
+
+        bool collect() {
+            Entry *e = m_head.exchange(nullptr, std::memory_order_acquire);
+            bool any = false;
+            for (; e; e = e->next) {
+                if (!e->reported) {
+                    e->reported = true;
+                    --m_pending;
+                    m_ready.push_back(e->index);
+                    any = true;
+                }
+            }
+            return any;
+        }
+
+        void waitReady(const std::chrono::steady_clock::time_point *deadline);
+
+        std::deque<Entry> m_entries;
+        std::atomic<Entry *> m_head;
+        std::atomic<uint32_t> m_signal;
+        std::size_t m_pending;
+        std::vector<std::size_t> m_ready;
+    };
+
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+
+    inline void AMWaitSet::waitReady(const std::chrono::steady_clock::time_point *deadline)
+    {
+        (void)deadline;
+        if (collect()) {
+            return;
+        }
+        for (Entry &e: m_entries) {
+            if (!e.reported) {
+                e.state->runDeferred();
+                e.state->poll();
+            }
+        }
+        collect();
+    }
+
+#else
+
+    inline void AMWaitSet::waitReady(const std::chrono::steady_clock::time_point *deadline) {
+        while (m_pending > 0) {
+            if (collect()) {
+                return;
+            }
+            uint32_t s = m_signal.load(std::memory_order_acquire);
+            if (!(s & 1u)) {
+                if (!m_signal.compare_exchange_strong(s, s | 1u, std::memory_order_acq_rel)) {
+                    continue;
+                }
+                s |= 1u;
+            }
+            bool expired = false;
+            if (!m_head.load(std::memory_order_acquire)) {
+                if (deadline) {
+                    auto now = std::chrono::steady_clock::now();
+                    if (now >= *deadline) {
+                        expired = true;
+                    } else {
+                        std::chrono::nanoseconds rest = *deadline - now;
+                        _AMParker::wait(m_signal, s, &rest);
+                    }
+                } else {
+                    _AMParker::wait(m_signal, s, nullptr);
+                }
+            }
+            // awake again, push() need not call the kernel until the next sleep
+            m_signal.fetch_and(~1u, std::memory_order_acquire);
+            if (expired) {
+                return;
+            }
+        }
+    }
+
+#endif
+
+}
+
 #endif //SAW_ALL_AMFUTURE_H
@@ -0,0 +1,3 @@
+// the configured options and settings for Tutorial
+#define AMFuture_VERSION_MAJOR 201909
+#define AMFuture_VERSION_MINOR 0
@@ -0,0 +1,357 @@
+/**
+ * @file: AMHedged.h
+ * Hedged AMAsync: second attempt of slow call, the first result wins
+ *
+ * @author Zdeněk Skulínek  &lt;<a href="mailto:zdenek.skulinek@seznam.cz">me@zdenekskulinek.cz</a>&gt;
+ */
+
+#ifndef SAW_ALL_AMHEDGED_H
+#define SAW_ALL_AMHEDGED_H
+
+#include "AMFuture.h"
+#include "AMTimerWheel.h"
+#include <vector>
+#include <algorithm>
+#include <mutex>
+
+namespace AMCore {
+
+    /**
+     * \brief When to start the second attempt of AMAsyncHedged call.
+     *
+     * Either after fixed delay, or at chosen percentile of latency of recent attempts. The percentile is computed
+     * again after every quarter of window of new attempts, not for every call. The policy is shared by many calls
+     * and must live, until all of them are finished (checkZombies() returns true).
+     *
+     * In multithreaded build, second attempts of all calls are armed on one timer wheel of the policy, its thread
+     * starts with the first call. Delay is rounded up to whole milliseconds.
+     */
+    class AMHedgePolicy {
+    public:
+        /**
+         * \brief Second attempt starts after fixed delay.
+         */
+        explicit AMHedgePolicy(std::chrono::microseconds delay)
+            : m_delay(delay.count()), m_percentile(0), m_samples(0), m_next(0), m_hedges(0) {
+        }
+
+        /**
+         * \brief Second attempt starts at percentile of observed latency.
+         * @param percentile for example 0.95
+         * @param initialDelay delay used, until there are enough samples
+         * @param window number of recent attempts, that are remembered
+         */
+        AMHedgePolicy(double percentile, std::chrono::microseconds initialDelay, std::size_t window = 256)
+            : m_delay(initialDelay.count()), m_percentile(percentile), m_samples(window), m_next(0), m_hedges(0) {
+            assert(percentile > 0 && percentile <= 1);
+            assert(window > 0);
+            m_sorted.reserve(window);
+        }
+
+        AMHedgePolicy(const AMHedgePolicy &other) = delete;
+
+        AMHedgePolicy &operator=(const AMHedgePolicy &other) = delete;
+
+        /**
+         * \brief Current delay of the second attempt.
+         */
+        std::chrono::microseconds delay() const noexcept {
+            return std::chrono::microseconds(m_delay.load(std::memory_order_relaxed));
+        }
+
+        /**
+         * \brief Remembers latency of finished attempt. Fixed policy ignores it.
+         */
+        void record(std::chrono::microseconds latency) noexcept {
+            if (m_samples.empty()) {
+                return;
+            }
+            uint64_t us = std::min<uint64_t>((uint64_t) std::max<int64_t>(latency.count(), 0), UINT32_MAX);
+            uint64_t n = m_next.fetch_add(1, std::memory_order_relaxed);
+            m_samples[n % m_samples.size()].store((uint32_t) us, std::memory_order_relaxed);
+            if ((n + 1) % std::max<std::size_t>(m_samples.size() / 4, 1) == 0) {
+                refresh(n + 1);
+            }
+        }
+
+        /**
+         * \brief Number of started second attempts, the extra cost of hedging.
+         */
+        uint64_t hedges() const noexcept {
+            return m_hedges.load(std::memory_order_relaxed);
+        }
+
+        void hedged() noexcept {
+            m_hedges.fetch_add(1, std::memory_order_relaxed);
+        }
+
+    protected:
+        template<class T> friend class _AMHedgedState;
+
+        static constexpr std::size_t minSamples = 8;
+
+        /**
+         * \brief Computes the percentile of remembered samples. Attempt, that comes meanwhile, does not wait for it.
+         * @param recorded number of all recorded samples
+         */
+        void refresh(uint64_t recorded) noexcept {
+            std::unique_lock<std::mutex> lock(m_mutex, std::try_to_lock);
+            if (!lock.owns_lock()) {
+                return;
+            }
+            std::size_t count = (std::size_t) std::min<uint64_t>(recorded, m_samples.size());
+            if (count < minSamples) {
+                return;
+            }
+            // capacity is reserved for whole window
+            m_sorted.resize(count);
+            for (std::size_t i = 0; i < count; ++i) {
+                m_sorted[i] = m_samples[i].load(std::memory_order_relaxed);
+            }
+            std::size_t k = (std::size_t) (m_percentile * (double) (count - 1));
+            std::nth_element(m_sorted.begin(), m_sorted.begin() + k, m_sorted.end());
+            m_delay.store(m_sorted[k], std::memory_order_relaxed);
+        }
+
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+        AMTimerWheel &timer() {
+            std::call_once(m_timerStarted, [this]() {
+                m_timer.start();
+            });
+            return m_timer;
+        }
+#endif
+
+        std::atomic<int64_t> m_delay;
+        double m_percentile;
+        std::vector<std::atomic<uint32_t>> m_samples;
+        std::atomic<uint64_t> m_next;
+        std::atomic<uint64_t> m_hedges;
+        std::mutex m_mutex;
+        std::vector<uint32_t> m_sorted;
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+        std::once_flag m_timerStarted;
+        AMTimerWheel m_timer;
+#endif
+    };
+
+    /**
+     * \brief Shared state of hedged call. Result is taken from the attempt, that has finished first.
+     */
+    template<class T>
+    class _AMHedgedState : public _AMSharedState<T> {
+    public:
+        _AMHedgedState(AMHedgePolicy &policy, _AMSharedState<T> *first, _AMSharedState<T> *second) noexcept
+            : m_policy(policy), m_attempts{first, second}, m_winner(-1) {
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+            m_launched = 0;
+            this->defer();
+#else
+            m_running.store(2, std::memory_order_relaxed);
+            m_timer = AMTimer{UINT32_MAX, 0};
+#endif
+        }
+
+        ~_AMHedgedState() {
+            m_attempts[0]->release();
+            m_attempts[1]->release();
+        }
+
+        T take() override {
+            return m_attempts[m_winner]->take();
+        }
+
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+        void run() noexcept override {
+            launch(0);
+        }
+
+        bool poll() override {
+            if (this->isReady()) {
+                return true;
+            }
+            for (int i = 0; i < m_launched; ++i) {
+                if (m_attempts[i]->poll()) {
+                    settle(i);
+                    return true;
+                }
+            }
+            if (m_launched == 1 && std::chrono::steady_clock::now() - m_started[0] >= m_policy.delay()) {
+                m_policy.hedged();
+                launch(1);
+                if (m_attempts[1]->poll()) {
+                    settle(1);
+                    return true;
+                }
+            }
+            return false;
+        }
+#else
+        /**
+         * \brief Arms the second attempt, runs the first one on the calling thread, then disarms the second one.
+         */
+        void run() noexcept override {
+            arm();
+            attempt(0);
+            disarm();
+        }
+
+        /**
+         * \brief Arms timer of the second attempt. Called before the first attempt starts.
+         */
+        void arm() noexcept {
+            this->addRef();
+            try {
+                m_timer = m_policy.timer().arm(std::chrono::steady_clock::now() + m_policy.delay(), [this]() {
+                    hedge();
+                    this->release();
+                });
+            } catch (...) {
+                // call goes on without hedging
+                this->release();
+                producerDone();
+            }
+        }
+
+        /**
+         * \brief Drops the second attempt, unless its timer has fired already.
+         */
+        void disarm() noexcept {
+            if (m_policy.timer().cancel(m_timer)) {
+                producerDone();
+                this->release();
+            }
+        }
+#endif
+
+    protected:
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+        void launch(int i) noexcept {
+            m_started[i] = std::chrono::steady_clock::now();
+            m_launched = i + 1;
+            m_attempts[i]->runDeferred();
+        }
+
+        void settle(int i) noexcept {
+            m_policy.record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_started[i]));
+            m_winner = i;
+            // unfinished loser is polled with other zombies, until its data source is done
+            if (m_launched == 2 && !m_attempts[1 - i]->poll()) {
+                _AMFutureZombieBase::add(m_attempts[1 - i]);
+            }
+            this->claim();
+            this->finishProducers();
+            this->markReady();
+        }
+
+        int m_launched;
+        std::chrono::steady_clock::time_point m_started[2];
+#else
+        /**
+         * \brief Called by timer. Starts the second attempt on its own thread, if the first one is late.
+         */
+        void hedge() noexcept {
+            if (this->isReady()) {
+                producerDone();
+                return;
+            }
+            m_policy.hedged();
+            this->addRef();
+            try {
+                std::thread([this]() {
+                    attempt(1);
+                    this->release();
+                }).detach();
+            } catch (...) {
+                this->release();
+                producerDone();
+            }
+        }
+
+        void attempt(int i) noexcept {
+            auto start = std::chrono::steady_clock::now();
+            m_attempts[i]->run();
+            m_policy.record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start));
+            if (this->claim()) {
+                m_winner = i;
+                this->markReady();
+            }
+            producerDone();
+        }
+
+        void producerDone() noexcept {
+            if (m_running.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                this->finishProducers();
+            }
+        }
+
+        std::atomic<int> m_running;
+        AMTimer m_timer;
+#endif
+
+        AMHedgePolicy &m_policy;
+        _AMSharedState<T> *m_attempts[2];
+        int m_winner;
+    };
+
+    /**
+     * \brief Creates attempts of hedged call and starts them.
+     */
+    class _AMHedgedLaunch {
+    public:
+        template<class Callback, class AvailCallback, class Function, class TCF, class... Args>
+        static AMFuture<std::invoke_result_t<std::decay_t<Callback>, TCF, void *>>
+        launch(_AMAt<AMHedgePolicy &> policy, Callback &&callback, AvailCallback &&a, Function &&f, TCF &&tcf, Args &&... args) {
+            typedef std::invoke_result_t<std::decay_t<Callback>, TCF, void *> T;
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+            typedef _AMLaunchFnHolder<T, std::decay_t<AvailCallback>, std::decay_t<Callback>, std::remove_reference_t<TCF>, std::decay_t<Function>, std::decay_t<Args>...> Attempt;
+            Attempt *first = new Attempt(tcf, std::decay_t<AvailCallback>(a), std::decay_t<Callback>(callback), std::decay_t<Function>(f), args...);
+            Attempt *second = new Attempt(tcf, std::move(a), std::move(callback), std::move(f), std::forward<Args>(args)...);
+            _AMHedgedState<T> *state = new _AMHedgedState<T>(policy.value, first, second);
+            state->watch(policy.site);
+            _AMRunQueue::push(state);
+#else
+            (void) a;
+            typedef _AMTaskState<T, std::decay_t<Function>, std::decay_t<Callback>, std::decay_t<TCF>, std::decay_t<Args>...> Attempt;
+            Attempt *first = new Attempt(f, callback, tcf, args...);
+            Attempt *second = new Attempt(
+                std::forward<Function>(f),
+                std::forward<Callback>(callback),
+                std::forward<TCF>(tcf),
+                std::forward<Args>(args)...
+                );
+            _AMHedgedState<T> *state = new _AMHedgedState<T>(policy.value, first, second);
+            state->watch(policy.site);
+            _AMLaunchThread(state, AMLaunch::async);
+#endif
+            return AMFuture<T>(state);
+        }
+    };
+
+    /**
+     * \brief asynchronous call with second attempt
+     *
+     * When the first attempt has not finished within the delay given by policy, second attempt with the same
+     * parameters starts. The first result wins, the other one is thrown away. Future of hedged call is settled,
+     * when both attempts are finished, so a late loser is kept with zombies, until it is done.
+     *
+     * Parameters are the same as for AMAsync, prepareData and getData must be safe to call twice at once.
+     * @param policy delay of the second attempt
+     * @return AMFuture<T>
+     */
+    template<class Callback, class AvailCallback, class Function, class TCF, class... Args>
+    AMFuture<std::invoke_result_t<std::decay_t<Callback>, TCF, void *>>
+    AMAsyncHedged(_AMAt<AMHedgePolicy &> policy, Callback &&callback, AvailCallback &&a, Function &&f, TCF &&tcf, Args &&... args) {
+        return _AMHedgedLaunch::launch(
+            policy,
+            std::forward<Callback>(callback),
+            std::forward<AvailCallback>(a),
+            std::forward<Function>(f),
+            std::forward<TCF>(tcf),
+            std::forward<Args>(args)...
+            );
+    }
+
+}
+
+#endif //SAW_ALL_AMHEDGED_H
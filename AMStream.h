@@ -0,0 +1,396 @@
+/**
+ * @file: AMStream.h
+ * Streaming AMAsync: producer pushes parts of result, consumer takes them, as they arrive
+ *
+ * @author Zdeněk Skulínek  &lt;<a href="mailto:zdenek.skulinek@seznam.cz">me@zdenekskulinek.cz</a>&gt;
+ */
+
+#ifndef SAW_ALL_AMSTREAM_H
+#define SAW_ALL_AMSTREAM_H
+
+#include "AMFuture.h"
+#include <vector>
+#include <iterator>
+
+namespace AMCore {
+
+    /**
+     * \brief Shared state of stream. Bounded ring with one producer and one consumer.
+     *
+     * Readiness of the state means, that the producer has finished. Its exception is thrown to the consumer after
+     * the last item. In singlethreaded build the producer can't wait for the consumer, so the ring is unbounded.
+     */
+    template<class T>
+    class _AMStreamState : public _AMValueState<void> {
+    public:
+        explicit _AMStreamState(std::size_t capacity)
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+            : m_cancelled(false) {
+            // the same contract as in multithreaded build, though the queue is not bounded here
+            assert(capacity > 0 && capacity <= (1u << 30));
+            (void) capacity;
+        }
+#else
+            : m_head(0), m_tail(0), m_dataEvents(0), m_spaceEvents(0), m_consumerWaiting(0), m_producerWaiting(0),
+              m_cancelled(false) {
+            assert(capacity > 0 && capacity <= (1u << 30));
+            std::size_t size = 1;
+            while (size < capacity) {
+                size <<= 1;
+            }
+            m_ring.resize(size);
+            m_mask = (uint32_t) (size - 1);
+        }
+#endif
+
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+        bool push(T &&value) {
+            if (m_cancelled) {
+                return false;
+            }
+            m_queue.push_back(std::move(value));
+            return true;
+        }
+
+        bool pop(std::optional<T> &out) {
+            runDeferred();
+            if (m_queue.empty()) {
+                return false;
+            }
+            out.emplace(std::move(m_queue.front()));
+            m_queue.pop_front();
+            return true;
+        }
+
+        void cancel() noexcept {
+            m_cancelled = true;
+            m_queue.clear();
+        }
+
+    protected:
+        void signalData() noexcept {
+        }
+
+        std::deque<T> m_queue;
+        bool m_cancelled;
+#else
+        /**
+         * \brief Puts item into ring. Waits, while the ring is full.
+         * @return false, if consumer is gone and the producer can stop
+         */
+        bool push(T &&value) {
+            uint32_t tail = m_tail.load(std::memory_order_relaxed);
+            for (int spin = 0;; ++spin) {
+                if (m_cancelled.load(std::memory_order_acquire)) {
+                    return false;
+                }
+                if (tail - m_head.load(std::memory_order_acquire) <= m_mask) {
+                    break;
+                }
+                if (spin < _AMParker::spinIterations) {
+                    _AMParker::relax();
+                    continue;
+                }
+                uint32_t seq = m_spaceEvents.load(std::memory_order_relaxed);
+                m_producerWaiting.store(1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (tail - m_head.load(std::memory_order_relaxed) > m_mask && !m_cancelled.load(std::memory_order_relaxed)) {
+                    _AMParker::wait(m_spaceEvents, seq, nullptr);
+                }
+            }
+            m_ring[tail & m_mask].emplace(std::move(value));
+            m_tail.store(tail + 1, std::memory_order_release);
+            signalData();
+            return true;
+        }
+
+        /**
+         * \brief Takes item from ring. Waits, while the ring is empty and the producer runs.
+         * @return false, if there will be no more items
+         */
+        bool pop(std::optional<T> &out) {
+            uint32_t head = m_head.load(std::memory_order_relaxed);
+            for (int spin = 0;; ++spin) {
+                if (m_tail.load(std::memory_order_acquire) != head) {
+                    break;
+                }
+                if (isReady()) {
+                    // items pushed just before the end
+                    if (m_tail.load(std::memory_order_acquire) != head) {
+                        break;
+                    }
+                    return false;
+                }
+                if (spin < _AMParker::spinIterations) {
+                    _AMParker::relax();
+                    continue;
+                }
+                uint32_t seq = m_dataEvents.load(std::memory_order_relaxed);
+                m_consumerWaiting.store(1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (m_tail.load(std::memory_order_relaxed) == head && !isReady()) {
+                    _AMParker::wait(m_dataEvents, seq, nullptr);
+                }
+            }
+            std::optional<T> &slot = m_ring[head & m_mask];
+            out.emplace(std::move(*slot));
+            slot.reset();
+            m_head.store(head + 1, std::memory_order_release);
+            signal(m_producerWaiting, m_spaceEvents);
+            return true;
+        }
+
+        /**
+         * \brief Consumer is gone. Producer stops at next push().
+         */
+        void cancel() noexcept {
+            m_cancelled.store(true, std::memory_order_release);
+            signal(m_producerWaiting, m_spaceEvents);
+        }
+
+    protected:
+        void signalData() noexcept {
+            signal(m_consumerWaiting, m_dataEvents);
+        }
+
+        /**
+         * \brief Wakes the other side, only if it sleeps or is going to sleep.
+         */
+        static void signal(std::atomic<uint32_t> &waiting, std::atomic<uint32_t> &events) noexcept {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (waiting.load(std::memory_order_relaxed) && waiting.exchange(0, std::memory_order_relaxed)) {
+                events.fetch_add(1, std::memory_order_release);
+                _AMParker::wakeAll(events);
+            }
+        }
+
+        std::vector<std::optional<T>> m_ring;
+        uint32_t m_mask;
+        std::atomic<uint32_t> m_head;
+        std::atomic<uint32_t> m_tail;
+        std::atomic<uint32_t> m_dataEvents;
+        std::atomic<uint32_t> m_spaceEvents;
+        std::atomic<uint32_t> m_consumerWaiting;
+        std::atomic<uint32_t> m_producerWaiting;
+        std::atomic<bool> m_cancelled;
+#endif
+    };
+
+    /**
+     * \brief Producer side of \ref AMStream. It is passed to the producer function.
+     */
+    template<class T>
+    class AMStreamWriter {
+    public:
+        explicit AMStreamWriter(_AMStreamState<T> *state) noexcept
+            : m_state(state) {
+        }
+
+        /**
+         * \brief Sends item to the consumer. In multithreaded build, waits, while the ring is full.
+         * @return false, if the consumer is gone. The producer should return then.
+         */
+        bool push(T value) {
+            return m_state->push(std::move(value));
+        }
+
+    protected:
+        _AMStreamState<T> *m_state;
+    };
+
+    /**
+     * \brief Stream state, that owns the launched producer.
+     */
+    template<class T, class Function, class TCF, class... Args>
+    class _AMStreamTask : public _AMStreamState<T> {
+    public:
+        template<class... U>
+        _AMStreamTask(std::size_t capacity, U &&... u)
+            : _AMStreamState<T>(capacity), m_bound(std::forward<U>(u)...) {
+        }
+
+        void run() noexcept override {
+            this->fulfil([this]() {
+                std::apply([this](Function &f, TCF &tcf, Args &... args) {
+                    AMStreamWriter<T> out(this);
+                    std::invoke(f, tcf, out, args...);
+                }, m_bound);
+            });
+            this->signalData();
+        }
+
+    protected:
+        std::tuple<Function, TCF, Args...> m_bound;
+    };
+
+    /**
+     * \brief Consumer side of streaming call. Items come in the order, in which they were pushed.
+     *
+     * \code
+     *    for (std::vector<char> &part: stream) { ... }
+     * \endcode
+     */
+    template<class T>
+    class AMStream {
+    public:
+        class iterator {
+        public:
+            typedef std::input_iterator_tag iterator_category;
+            typedef T value_type;
+            typedef std::ptrdiff_t difference_type;
+            typedef T *pointer;
+            typedef T &reference;
+
+            iterator() noexcept
+                : m_stream(nullptr) {
+            }
+
+            explicit iterator(AMStream *stream)
+                : m_stream(stream) {
+                ++*this;
+            }
+
+            T &operator*() {
+                return *m_item;
+            }
+
+            T *operator->() {
+                return &*m_item;
+            }
+
+            iterator &operator++() {
+                m_item = m_stream->next();
+                if (!m_item) {
+                    m_stream = nullptr;
+                }
+                return *this;
+            }
+
+            bool operator==(const iterator &other) const noexcept {
+                return m_stream == other.m_stream;
+            }
+
+            bool operator!=(const iterator &other) const noexcept {
+                return m_stream != other.m_stream;
+            }
+
+        protected:
+            AMStream *m_stream;
+            std::optional<T> m_item;
+        };
+
+        AMStream() noexcept
+            : m_state(nullptr) {
+        }
+
+        explicit AMStream(_AMStreamState<T> *state) noexcept
+            : m_state(state) {
+        }
+
+        AMStream(AMStream &&other) noexcept
+            : m_state(other.m_state) {
+            other.m_state = nullptr;
+        }
+
+        AMStream &operator=(AMStream &&other) noexcept {
+            if (this != &other) {
+                close();
+                m_state = other.m_state;
+                other.m_state = nullptr;
+            }
+            return *this;
+        }
+
+        AMStream(const AMStream &other) = delete;
+
+        AMStream &operator=(const AMStream &other) = delete;
+
+        /**
+         * \brief destructor. Producer, that still runs, gets false from push() and is kept with zombies.
+         */
+        ~AMStream() {
+            close();
+        }
+
+        /**
+         * \brief Checks, that there can be more items.
+         */
+        bool valid() const noexcept {
+            return m_state != nullptr;
+        }
+
+        /**
+         * \brief Waits for next item.
+         * @return the item, or nothing after the last one
+         * @throw exception of the producer, after the last item
+         */
+        std::optional<T> next() {
+            std::optional<T> item;
+            if (!m_state) {
+                return item;
+            }
+            if (!m_state->pop(item)) {
+                AMFuture<void> done(m_state);
+                m_state = nullptr;
+                done.get();
+            }
+            return item;
+        }
+
+        iterator begin() {
+            return iterator(this);
+        }
+
+        iterator end() noexcept {
+            return iterator();
+        }
+
+    protected:
+        void close() noexcept {
+            if (m_state) {
+                m_state->cancel();
+                AMFuture<void> done(m_state);
+                m_state = nullptr;
+            }
+        }
+
+        _AMStreamState<T> *m_state;
+    };
+
+    /**
+     * \brief asynchronous call, that produces result in parts
+     *
+     * Function is member function of TCF: void produce(AMStreamWriter<T> &out, Args... args). It pushes items by
+     * out.push(item). In multithreaded build it runs on its own thread and waits, while capacity items are not taken.
+     *
+     * In singlethreaded build it is queued like AMAsync call and run by AMPump() or by the first next(). Without threads
+     * the producer can't be suspended in push(), so it runs to its end at once and all items are kept: the first item
+     * comes no sooner and memory is no lower than with AMAsync returning a vector. capacity is only checked there.
+     *
+     * @tparam T type of item
+     * @param capacity maximal number of items, that wait for the consumer
+     * @param f producer function
+     * @param tcf caller object, it is copied in multithreaded build
+     * @param args parameters of f
+     * @return AMStream<T>
+     */
+    template<class T, class Function, class TCF, class... Args>
+    AMStream<T> AMAsyncStream(_AMAt<std::size_t> capacity, Function &&f, TCF &&tcf, Args &&... args) {
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+        typedef _AMStreamTask<T, std::decay_t<Function>, std::reference_wrapper<std::remove_reference_t<TCF>>, std::decay_t<Args>...> State;
+        State *state = new State(capacity.value, std::forward<Function>(f), std::ref(tcf), std::forward<Args>(args)...);
+        state->watch(capacity.site);
+        state->defer();
+        _AMRunQueue::push(state);
+#else
+        typedef _AMStreamTask<T, std::decay_t<Function>, std::decay_t<TCF>, std::decay_t<Args>...> State;
+        State *state = new State(capacity.value, std::forward<Function>(f), std::forward<TCF>(tcf), std::forward<Args>(args)...);
+        state->watch(capacity.site);
+        _AMLaunchThread(state, AMLaunch::async);
+#endif
+        return AMStream<T>(state);
+    }
+
+}
+
+#endif //SAW_ALL_AMSTREAM_H
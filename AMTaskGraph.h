@@ -0,0 +1,517 @@
+/**
+ * @file: AMTaskGraph.h
+ * Graph of AMAsync calls, where some calls need results of others
+ *
+ * @author Zdeněk Skulínek  &lt;<a href="mailto:zdenek.skulinek@seznam.cz">me@zdenekskulinek.cz</a>&gt;
+ */
+
+#ifndef SAW_ALL_AMTASKGRAPH_H
+#define SAW_ALL_AMTASKGRAPH_H
+
+#include "AMFuture.h"
+#include <vector>
+#include <tuple>
+#include <stdexcept>
+
+namespace AMCore {
+
+    /**
+     * \brief Handle of node of \ref AMTaskGraph, that produces result of type T.
+     */
+    template<class T>
+    class AMTaskNode {
+    public:
+        std::size_t index;
+    };
+
+    /**
+     * \brief Execution of the graph. It is the shared state of AMFuture returned by AMTaskGraph::run().
+     */
+    class _AMGraphRun : public _AMValueState<void> {
+    public:
+        _AMGraphRun(std::size_t nodes) noexcept
+            : m_remaining(nodes), m_failed(false), m_progress(false)
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+            , m_finished(0)
+#endif
+        {
+        }
+
+        /**
+         * \brief Node is finished. The last one makes the run ready.
+         */
+        void nodeDone() noexcept {
+            if (m_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                complete();
+            }
+        }
+
+        /**
+         * \brief Remembers the first failure of a node.
+         */
+        void fail(std::exception_ptr e) noexcept {
+            bool expected = false;
+            if (m_failed.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+                m_error = e;
+            }
+        }
+
+        void complete() noexcept {
+            addRef();
+            fulfil([this]() {
+                if (m_failed.load(std::memory_order_acquire)) {
+                    std::rethrow_exception(m_error);
+                }
+            });
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+            if (m_finished.exchange(1, std::memory_order_acq_rel) == 2) {
+                _AMParker::wakeAll(m_finished);
+            }
+#endif
+            release();
+        }
+
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+        /**
+         * \brief Runs the queue, until the graph is done or no node can make progress.
+         */
+        void run() noexcept override
+        {
+            std::size_t idle = 0;
+            while (!isReady() && idle <= _AMRunQueue::size()) {
+                m_progress = false;
+                if (!_AMRunQueue::runOne()) {
+                    break;
+                }
+                idle = m_progress ? 0 : idle + 1;
+            }
+        }
+#else
+        /**
+         * \brief Waits, until all nodes are finished. Unlike wait(), it does not return early, when the run expires.
+         */
+        void waitFinished() {
+            wait();
+            if (isSettled()) {
+                return;
+            }
+            uint32_t expected = 0;
+            m_finished.compare_exchange_strong(expected, 2, std::memory_order_acq_rel);
+            while (m_finished.load(std::memory_order_acquire) != 1) {
+                _AMParker::wait(m_finished, 2, nullptr);
+            }
+        }
+#endif
+
+        std::atomic<std::size_t> m_remaining;
+        std::atomic<bool> m_failed;
+        std::exception_ptr m_error;
+        bool m_progress;
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+        std::atomic<uint32_t> m_finished; ///< 1 all nodes are finished, 2 waitFinished() sleeps
+#endif
+    };
+
+    /**
+     * \brief Type independent node of the graph.
+     */
+    class _AMTaskNodeBase : public _AMStateBase {
+    public:
+        _AMTaskNodeBase(AMTaskGraph *graph) noexcept
+            : m_graph(graph), m_index(0), m_predecessors(0), m_pending(0), m_skip(false), m_prepared(false), m_mem(nullptr) {
+        }
+
+        void run() noexcept override;
+
+        /**
+         * \brief Calls prepareData().
+         */
+        virtual void prepare() = 0;
+
+        /**
+         * \brief Calls AvailCallback.
+         */
+        virtual bool avail() = 0;
+
+        /**
+         * \brief Calls getData() and stores result.
+         */
+        virtual void finish() = 0;
+
+        /**
+         * \brief Forgets result of previous run.
+         */
+        virtual void reset() noexcept = 0;
+
+        AMTaskGraph *m_graph;
+        std::size_t m_index;
+        std::vector<_AMTaskNodeBase *> m_successors;
+        std::size_t m_predecessors;
+        std::atomic<std::size_t> m_pending;
+        std::atomic<bool> m_skip;
+        bool m_prepared;
+        void *m_mem;
+    };
+
+    /**
+     * \brief Node, that stores result of type T.
+     */
+    template<class T>
+    class _AMTaskNodeResult : public _AMTaskNodeBase {
+    public:
+        typedef std::conditional_t<std::is_reference_v<T>, std::reference_wrapper<std::remove_reference_t<T>>, T> Stored;
+
+        _AMTaskNodeResult(AMTaskGraph *graph) noexcept
+            : _AMTaskNodeBase(graph) {
+        }
+
+        T &result() {
+            if (!m_value) {
+                // the node failed or was skipped, like a promise destroyed without result
+                std::rethrow_exception(_AMBrokenPromise());
+            }
+            return *m_value;
+        }
+
+        void reset() noexcept override {
+            m_value.reset();
+            m_prepared = false;
+            m_mem = nullptr;
+        }
+
+    protected:
+        std::optional<Stored> m_value;
+    };
+
+    template<>
+    class _AMTaskNodeResult<void> : public _AMTaskNodeBase {
+    public:
+        _AMTaskNodeResult(AMTaskGraph *graph) noexcept
+            : _AMTaskNodeBase(graph) {
+        }
+
+        void reset() noexcept override {
+            m_prepared = false;
+            m_mem = nullptr;
+        }
+    };
+
+    template<class T, class Callback, class AvailCallback, class Function, class TCF, class... Args>
+    class _AMTaskNode : public _AMTaskNodeResult<T> {
+    public:
+        template<class... U>
+        _AMTaskNode(AMTaskGraph *graph, U &&... u)
+            : _AMTaskNodeResult<T>(graph), m_bound(std::forward<U>(u)...) {
+        }
+
+        void prepare() override {
+            this->m_mem = std::apply([](Callback &, AvailCallback &, Function &f, TCF &tcf, Args &... args) {
+                return std::invoke(f, tcf, args...);
+            }, m_bound);
+        }
+
+        bool avail() override {
+            return std::invoke(std::get<1>(m_bound), std::get<3>(m_bound), this->m_mem);
+        }
+
+        void finish() override {
+            if constexpr (std::is_void_v<T>) {
+                std::invoke(std::get<0>(m_bound), std::get<3>(m_bound), this->m_mem);
+            } else {
+                this->m_value.emplace(std::invoke(std::get<0>(m_bound), std::get<3>(m_bound), this->m_mem));
+            }
+        }
+
+    protected:
+        std::tuple<Callback, AvailCallback, Function, TCF, Args...> m_bound;
+    };
+
+    /**
+     * \brief Graph of AMAsync calls.
+     *
+     * Each node is the usual triple Callback, AvailCallback and Function with its caller object and parameters.
+     * Edges say, which node must be finished before another one starts. Node starts, as soon as all its
+     * predecessors are finished, so independent branches run in parallel.
+     *
+     * The graph is built once and run many times. Caller object and parameters are copied into the node,
+     * use std::ref() to share the caller object. Results of predecessors are available by result() in prepareData().
+     *
+     * In singlethreaded build, nodes are queued and run by AMPump(). get() of the run runs the queue itself.
+     */
+    class AMTaskGraph {
+    public:
+        AMTaskGraph() noexcept
+            : m_run(nullptr), m_checked(true) {
+        }
+
+        AMTaskGraph(const AMTaskGraph &other) = delete;
+
+        AMTaskGraph &operator=(const AMTaskGraph &other) = delete;
+
+        /**
+         * \brief destructor. Waits, until the running execution is finished.
+         */
+        ~AMTaskGraph();
+
+        /**
+         * \brief Adds node.
+         *
+         * @tparam Callback Get data function. Return type is T. It must be member function of type TCF.
+         * @tparam AvailCallback Check, if data is available. It must be member function of type TCF.
+         * @tparam Function Prepare data function. Return type is a tag of void *. It must be member function of type TCF.
+         * @tparam TCF Caller object type.
+         * @tparam Args All parameters of Function.
+         * @param callback Callback type function.
+         * @param a AvailCallback type function.
+         * @param f Function type function.
+         * @param tcf Caller object.
+         * @param args Free paramater that f have.
+         * @return handle of the node
+         */
+        template<class Callback, class AvailCallback, class Function, class TCF, class... Args>
+        AMTaskNode<std::invoke_result_t<std::decay_t<Callback>, std::decay_t<TCF> &, void *>>
+        add(Callback &&callback, AvailCallback &&a, Function &&f, TCF &&tcf, Args &&... args) {
+            typedef std::invoke_result_t<std::decay_t<Callback>, std::decay_t<TCF> &, void *> T;
+            assert(!running());
+            _AMTaskNodeBase *node = new _AMTaskNode<T, std::decay_t<Callback>, std::decay_t<AvailCallback>, std::decay_t<Function>, std::decay_t<TCF>, std::decay_t<Args>...>(
+                this,
+                std::forward<Callback>(callback),
+                std::forward<AvailCallback>(a),
+                std::forward<Function>(f),
+                std::forward<TCF>(tcf),
+                std::forward<Args>(args)...
+                );
+            node->m_index = m_nodes.size();
+            m_nodes.push_back(node);
+            return AMTaskNode<T>{m_nodes.size() - 1};
+        }
+
+        /**
+         * \brief Adds edge: after does not start, until before is finished.
+         */
+        template<class A, class B>
+        void precede(AMTaskNode<A> before, AMTaskNode<B> after) {
+            assert(!running());
+            assert(before.index < m_nodes.size() && after.index < m_nodes.size());
+            m_nodes[before.index]->m_successors.push_back(m_nodes[after.index]);
+            ++m_nodes[after.index]->m_predecessors;
+            m_checked = false;
+        }
+
+        /**
+         * \brief Starts execution of whole graph. Previous execution must be finished.
+         * @return future, that is ready, when all nodes are finished. get() throws the first exception of a node.
+         * @throw std::logic_error, if edges make a cycle
+         */
+        AMFuture<void> run();
+
+        /**
+         * \brief Result of finished node of the last execution.
+         * @throw std::logic_error (std::future_error, where available), if the node failed or was skipped after failure of its predecessor
+         */
+        template<class T>
+        T &result(AMTaskNode<T> node) {
+            assert(node.index < m_nodes.size());
+            return static_cast<_AMTaskNodeResult<T> *>(m_nodes[node.index])->result();
+        }
+
+        /**
+         * \brief Number of nodes.
+         */
+        std::size_t size() const noexcept {
+            return m_nodes.size();
+        }
+
+    protected:
+        friend class _AMTaskNodeBase;
+
+        /**
+         * \brief Expired run is ready, while its nodes still run. Only settled run is over.
+         */
+        bool running() const noexcept {
+            return m_run && !m_run->isSettled();
+        }
+
+        bool acyclic() const;
+
+        void launch(_AMTaskNodeBase *node);
+
+        _AMTaskNodeBase *finished(_AMTaskNodeBase *node, bool failed);
+
+        std::vector<_AMTaskNodeBase *> m_nodes;
+        _AMGraphRun *m_run;
+        bool m_checked;
+    };
+
+    inline AMTaskGraph::~AMTaskGraph() {
+        if (m_run) {
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+            m_run->runDeferred();
+            while (!m_run->isSettled() && _AMRunQueue::runOne()) {
+            }
+            assert(m_run->isSettled());
+#else
+            m_run->waitFinished();
+#endif
+            m_run->release();
+        }
+        for (_AMTaskNodeBase *node: m_nodes) {
+            node->release();
+        }
+    }
+
+    inline bool AMTaskGraph::acyclic() const {
+        std::vector<std::size_t> pending;
+        std::vector<const _AMTaskNodeBase *> ready;
+        pending.reserve(m_nodes.size());
+        for (const _AMTaskNodeBase *node: m_nodes) {
+            pending.push_back(node->m_predecessors);
+            if (node->m_predecessors == 0) {
+                ready.push_back(node);
+            }
+        }
+        std::size_t visited = 0;
+        while (!ready.empty()) {
+            const _AMTaskNodeBase *node = ready.back();
+            ready.pop_back();
+            ++visited;
+            for (const _AMTaskNodeBase *s: node->m_successors) {
+                if (--pending[s->m_index] == 0) {
+                    ready.push_back(s);
+                }
+            }
+        }
+        return visited == m_nodes.size();
+    }
+
+    inline AMFuture<void> AMTaskGraph::run() {
+        assert(!running());
+        if (!m_checked) {
+            if (!acyclic()) {
+                throw std::logic_error("AMTaskGraph: edges make a cycle");
+            }
+            m_checked = true;
+        }
+        if (m_run) {
+            m_run->release();
+        }
+        m_run = new _AMGraphRun(m_nodes.size());
+        m_run->addRef();
+        for (_AMTaskNodeBase *node: m_nodes) {
+            node->reset();
+            node->m_skip.store(false, std::memory_order_relaxed);
+            node->m_pending.store(node->m_predecessors, std::memory_order_relaxed);
+        }
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+        m_run->defer();
+#endif
+        if (m_nodes.empty()) {
+            m_run->complete();
+        } else {
+            std::vector<_AMTaskNodeBase *> roots;
+            for (_AMTaskNodeBase *node: m_nodes) {
+                if (node->m_predecessors == 0) {
+                    roots.push_back(node);
+                }
+            }
+            for (_AMTaskNodeBase *node: roots) {
+                launch(node);
+            }
+        }
+        return AMFuture<void>(m_run);
+    }
+
+    inline _AMTaskNodeBase *AMTaskGraph::finished(_AMTaskNodeBase *node, bool failed) {
+        _AMTaskNodeBase *next = nullptr;
+        _AMGraphRun *run = m_run;
+        for (_AMTaskNodeBase *s: node->m_successors) {
+            if (failed) {
+                s->m_skip.store(true, std::memory_order_relaxed);
+            }
+            if (s->m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                if (next) {
+                    launch(next);
+                }
+                next = s;
+            }
+        }
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+        run->m_progress = true;
+        if (next) {
+            launch(next);
+            next = nullptr;
+        }
+#endif
+        // the graph may be destroyed, as soon as the last node is done
+        run->nodeDone();
+        return next;
+    }
+
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+
+    inline void AMTaskGraph::launch(_AMTaskNodeBase* node)
+    {
+        node->defer();
+        _AMRunQueue::push(node);
+    }
+
+    inline void _AMTaskNodeBase::run() noexcept
+    {
+        AMTaskGraph* graph = m_graph;
+        bool failed = m_skip.load(std::memory_order_relaxed);
+        if (!failed) {
+            try {
+                if (!m_prepared) {
+                    prepare();
+                    m_prepared = true;
+                    graph->m_run->m_progress = true;
+                }
+                if (!avail()) {
+                    graph->launch(this);
+                    return;
+                }
+                finish();
+            } catch (...) {
+                graph->m_run->fail(std::current_exception());
+                failed = true;
+            }
+        }
+        graph->finished(this, failed);
+    }
+
+#else
+
+    inline void AMTaskGraph::launch(_AMTaskNodeBase *node) {
+        // the graph keeps owning the node, the launch takes reference of its own
+        node->addRef();
+        try {
+            _AMLaunchThread(node, AMLaunch::async);
+        } catch (...) {
+            node->run();
+            return;
+        }
+        node->release();
+    }
+
+    inline void _AMTaskNodeBase::run() noexcept {
+        for (_AMTaskNodeBase *node = this; node;) {
+            AMTaskGraph *graph = node->m_graph;
+            bool failed = node->m_skip.load(std::memory_order_acquire);
+            if (!failed) {
+                try {
+                    node->prepare();
+                    node->finish();
+                } catch (...) {
+                    graph->m_run->fail(std::current_exception());
+                    failed = true;
+                }
+            }
+            node = graph->finished(node, failed);
+        }
+    }
+
+#endif
+
+}
+
+#endif //SAW_ALL_AMTASKGRAPH_H
@@ -0,0 +1,367 @@
+/**
+ * @file: AMTimerWheel.h
+ * Hierarchical timer wheel for deadlines of many futures
+ *
+ * @author Zdeněk Skulínek  &lt;<a href="mailto:zdenek.skulinek@seznam.cz">me@zdenekskulinek.cz</a>&gt;
+ */
+
+#ifndef SAW_ALL_AMTIMERWHEEL_H
+#define SAW_ALL_AMTIMERWHEEL_H
+
+#include "AMFuture.h"
+#include <vector>
+#include <functional>
+#include <mutex>
+#include <algorithm>
+
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+#include <thread>
+#include <condition_variable>
+#endif
+
+namespace AMCore {
+
+    /**
+     * \brief Handle of armed timer. It can be cancelled by AMTimerWheel::cancel().
+     */
+    class AMTimer {
+    public:
+        uint32_t index;
+        uint32_t generation;
+    };
+
+    /**
+     * \brief Handler, that expires the shared state of a future.
+     */
+    class _AMExpireHandler {
+    public:
+        _AMExpireHandler(_AMStateBase *state) noexcept
+            : m_state(state) {
+            m_state->addRef();
+        }
+
+        _AMExpireHandler(const _AMExpireHandler &other) noexcept
+            : m_state(other.m_state) {
+            m_state->addRef();
+        }
+
+        _AMExpireHandler &operator=(const _AMExpireHandler &other) = delete;
+
+        ~_AMExpireHandler() {
+            m_state->release();
+        }
+
+        void operator()() const noexcept {
+            m_state->expire();
+        }
+
+    protected:
+        _AMStateBase *m_state;
+    };
+
+    /**
+     * \brief Hierarchical timer wheel.
+     *
+     * Arming and cancelling a timer costs O(1), whatever number of timers is armed. Time is divided into ticks of
+     * given resolution, six levels of 64 slots cover 2^36 ticks, farther timers wait in an overflow list.
+     * Handlers are called by advance(), outside of the internal lock, so they may arm and cancel timers.
+     *
+     * In multithreaded build, start() runs a thread, that services all timers. In singlethreaded build,
+     * call advance() once per frame, together with AMPump().
+     */
+    class AMTimerWheel {
+    public:
+        typedef std::chrono::steady_clock Clock;
+
+        /**
+         * \brief constructor
+         * @param resolution length of one tick
+         */
+        explicit AMTimerWheel(std::chrono::microseconds resolution = std::chrono::milliseconds(1))
+            : m_resolution(resolution), m_origin(Clock::now()), m_current(0), m_count(0), m_free(none)
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+            , m_stop(false)
+#endif
+        {
+            assert(resolution.count() > 0);
+            for (uint32_t &head: m_slots) {
+                head = none;
+            }
+        }
+
+        AMTimerWheel(const AMTimerWheel &other) = delete;
+
+        AMTimerWheel &operator=(const AMTimerWheel &other) = delete;
+
+        /**
+         * \brief destructor. Stops service thread. Pending timers are dropped without calling.
+         */
+        ~AMTimerWheel() {
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+            stop();
+#endif
+        }
+
+        /**
+         * \brief Arms timer.
+         * @param deadline time, when handler is called
+         * @param handler function called once, from advance()
+         * @return handle for cancel()
+         */
+        AMTimer arm(Clock::time_point deadline, std::function<void()> handler) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            uint32_t index = m_free;
+            if (index == none) {
+                index = (uint32_t) m_nodes.size();
+                m_nodes.emplace_back();
+            } else {
+                m_free = m_nodes[index].next;
+            }
+            Node &node = m_nodes[index];
+            node.tick = std::max(toTick(deadline), m_current + 1);
+            node.handler = std::move(handler);
+            node.armed = true;
+            insert(index);
+            ++m_count;
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+            if (m_count == 1) {
+                m_wake.notify_one();
+            }
+#endif
+            return AMTimer{index, node.generation};
+        }
+
+        /**
+         * \brief Expires the future at deadline, unless it is ready before.
+         *
+         * get() of expired future throws AMFutureTimeout, result of late producer is thrown away.
+         * @param future valid future
+         * @param deadline time, when the future expires
+         * @return handle for cancel()
+         */
+        template<class T>
+        AMTimer expire(const AMFuture<T> &future, Clock::time_point deadline) {
+            assert(future.m_state);
+            return arm(deadline, _AMExpireHandler(future.m_state));
+        }
+
+        /**
+         * \brief Cancels timer.
+         * @param timer handle returned by arm()
+         * @return true, if the timer was armed and will not be called
+         */
+        bool cancel(AMTimer timer) {
+            std::function<void()> handler;
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (timer.index >= m_nodes.size()) {
+                return false;
+            }
+            Node &node = m_nodes[timer.index];
+            if (!node.armed || node.generation != timer.generation) {
+                return false;
+            }
+            unlink(timer.index);
+            handler.swap(node.handler);
+            recycle(timer.index);
+            --m_count;
+            return true;
+        }
+
+        /**
+         * \brief Calls handlers of all timers with deadline before now.
+         * @param now current time
+         * @return number of called handlers
+         */
+        std::size_t advance(Clock::time_point now = Clock::now()) {
+            std::vector<std::function<void()>> fired;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                uint64_t target = toTickFloor(now);
+                while (m_current < target && m_count > fired.size()) {
+                    ++m_current;
+                    for (int level = levels; level > 0; --level) {
+                        if ((m_current & ((uint64_t(1) << (bits * level)) - 1)) == 0) {
+                            cascade(level);
+                        }
+                    }
+                    uint32_t &head = slot(0, m_current & mask);
+                    while (head != none) {
+                        uint32_t index = head;
+                        unlink(index);
+                        fired.emplace_back(std::move(m_nodes[index].handler));
+                        recycle(index);
+                    }
+                }
+                m_count -= fired.size();
+                if (m_current < target) {
+                    m_current = target;
+                }
+            }
+            for (std::function<void()> &handler: fired) {
+                handler();
+            }
+            return fired.size();
+        }
+
+        /**
+         * \brief Number of armed timers.
+         */
+        std::size_t size() const {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_count;
+        }
+
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+        /**
+         * \brief Starts thread, that calls advance() every tick, while some timer is armed.
+         */
+        void start() {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_thread.joinable()) {
+                return;
+            }
+            m_stop = false;
+            m_thread = std::thread([this]() {
+                service();
+            });
+        }
+
+        /**
+         * \brief Stops the service thread.
+         */
+        void stop() {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stop = true;
+            }
+            m_wake.notify_one();
+            if (m_thread.joinable()) {
+                m_thread.join();
+            }
+        }
+#endif
+
+    protected:
+        static constexpr int bits = 6;
+        static constexpr int levels = 6;
+        static constexpr uint64_t mask = (1u << bits) - 1;
+        static constexpr uint32_t none = UINT32_MAX;
+
+        class Node {
+        public:
+            uint64_t tick = 0;
+            uint32_t prev = none;
+            uint32_t next = none;
+            uint32_t generation = 0;
+            uint32_t list = none;
+            bool armed = false;
+            std::function<void()> handler;
+        };
+
+        uint64_t toTick(Clock::time_point t) const {
+            if (t <= m_origin) {
+                return 0;
+            }
+            auto d = std::chrono::duration_cast<std::chrono::microseconds>(t - m_origin);
+            return (uint64_t) ((d + m_resolution - std::chrono::microseconds(1)) / m_resolution);
+        }
+
+        uint64_t toTickFloor(Clock::time_point t) const {
+            if (t <= m_origin) {
+                return 0;
+            }
+            return (uint64_t) (std::chrono::duration_cast<std::chrono::microseconds>(t - m_origin) / m_resolution);
+        }
+
+        uint32_t &slot(int level, uint64_t index) {
+            return m_slots[level * (mask + 1) + index];
+        }
+
+        void insert(uint32_t index) {
+            Node &node = m_nodes[index];
+            uint32_t list = levels * (mask + 1);
+            for (int level = 0; level < levels; ++level) {
+                if ((node.tick >> (bits * (level + 1))) == (m_current >> (bits * (level + 1)))) {
+                    list = level * (mask + 1) + ((node.tick >> (bits * level)) & mask);
+                    break;
+                }
+            }
+            uint32_t &head = m_slots[list];
+            node.list = list;
+            node.prev = none;
+            node.next = head;
+            if (head != none) {
+                m_nodes[head].prev = index;
+            }
+            head = index;
+        }
+
+        void unlink(uint32_t index) {
+            Node &node = m_nodes[index];
+            if (node.prev != none) {
+                m_nodes[node.prev].next = node.next;
+            } else {
+                m_slots[node.list] = node.next;
+            }
+            if (node.next != none) {
+                m_nodes[node.next].prev = node.prev;
+            }
+        }
+
+        void recycle(uint32_t index) {
+            Node &node = m_nodes[index];
+            node.armed = false;
+            node.handler = nullptr;
+            ++node.generation;
+            node.next = m_free;
+            m_free = index;
+        }
+
+        void cascade(int level) {
+            uint32_t &head = level == levels ? m_slots[levels * (mask + 1)] : slot(level, (m_current >> (bits * level)) & mask);
+            uint32_t index = head;
+            head = none;
+            while (index != none) {
+                uint32_t next = m_nodes[index].next;
+                insert(index);
+                index = next;
+            }
+        }
+
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+        void service() {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (!m_stop) {
+                if (m_count == 0) {
+                    m_wake.wait(lock);
+                    continue;
+                }
+                m_wake.wait_for(lock, m_resolution);
+                if (m_stop) {
+                    break;
+                }
+                lock.unlock();
+                advance();
+                lock.lock();
+            }
+        }
+#endif
+
+        std::chrono::microseconds m_resolution;
+        Clock::time_point m_origin;
+        uint64_t m_current;
+        std::size_t m_count;
+        uint32_t m_free;
+        std::vector<Node> m_nodes;
+        uint32_t m_slots[levels * (mask + 1) + 1];
+        mutable std::mutex m_mutex;
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+        bool m_stop;
+        std::condition_variable m_wake;
+        std::thread m_thread;
+#endif
+    };
+
+}
+
+#endif //SAW_ALL_AMTIMERWHEEL_H
@@ -0,0 +1,308 @@
+/**
+ * @file: AMWatchdog.h
+ * Watchdog of AMAsync calls, that run too long
+ *
+ * @author Zdeněk Skulínek  &lt;<a href="mailto:zdenek.skulinek@seznam.cz">me@zdenekskulinek.cz</a>&gt;
+ */
+
+#ifndef SAW_ALL_AMWATCHDOG_H
+#define SAW_ALL_AMWATCHDOG_H
+
+#include "AMFuture.h"
+#include <vector>
+#include <functional>
+#include <mutex>
+#include <unistd.h>
+
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+#include <thread>
+#include <condition_variable>
+#endif
+
+namespace AMCore {
+
+    /**
+     * \brief One running AMAsync call.
+     */
+    class AMWatchRecord {
+    public:
+        const void *state;              ///< identity of the call
+        const char *site;               ///< label of AMWatchSite, or source file of the call
+        int line;                       ///< line of the call in site, 0 for label
+        std::chrono::nanoseconds age;   ///< time since launch
+        bool zombie;                    ///< future of the call is destroyed already
+    };
+
+    /**
+     * \brief Labels AMAsync calls launched by this thread, while it exists.
+     *
+     * \code
+     *    AMWatchSite site("texture loader");
+     *    AMFuture<int> future = AMAsync(...);
+     * \endcode
+     */
+    class AMWatchSite {
+    public:
+        /**
+         * \brief constructor
+         * @param site label, that must live as long as the calls, usually string literal
+         */
+        explicit AMWatchSite(const char *site) noexcept
+            : m_previous(_AMWatchTable::threadSite()) {
+            _AMWatchTable::threadSite() = site;
+        }
+
+        AMWatchSite(const AMWatchSite &other) = delete;
+
+        AMWatchSite &operator=(const AMWatchSite &other) = delete;
+
+        ~AMWatchSite() {
+            _AMWatchTable::threadSite() = m_previous;
+        }
+
+    protected:
+        const char *m_previous;
+    };
+
+#define AM_WATCH_STR2(x) #x
+#define AM_WATCH_STR(x) AM_WATCH_STR2(x)
+    /**
+     * \brief Labels AMAsync calls of the current scope by file and line.
+     */
+#define AM_WATCH_SITE() AMCore::AMWatchSite _amWatchSite(__FILE__ ":" AM_WATCH_STR(__LINE__))
+
+    /**
+     * \brief Watchdog of AMAsync calls.
+     *
+     * When enabled, every AMAsync call is registered with its launch time and call site, until its producer finishes.
+     * Registration claims a slot of fixed table by compare and swap, so launching and finishing calls never lock.
+     * Calls launched, while the watchdog is disabled, are not watched.
+     *
+     * scan() reports calls, that run longer than threshold, once each. snapshot() and dump() list all running calls,
+     * dump() is safe to call from signal handler.
+     */
+    class AMWatchdog {
+    public:
+        typedef std::function<void(const AMWatchRecord &record)> Handler;
+
+        /**
+         * \brief Starts watching of new AMAsync calls.
+         */
+        static void enable() noexcept {
+            _AMWatchTable::instance();
+            usedFlag().store(true, std::memory_order_release);
+            _AMWatchTable::enabled().store(true, std::memory_order_relaxed);
+        }
+
+        /**
+         * \brief Stops watching of new AMAsync calls. Watched calls are still listed, until they finish.
+         */
+        static void disable() noexcept {
+            _AMWatchTable::enabled().store(false, std::memory_order_relaxed);
+        }
+
+        /**
+         * \brief Lists running calls.
+         */
+        static std::vector<AMWatchRecord> snapshot() {
+            std::vector<AMWatchRecord> records;
+            visit([&records](_AMWatchTable::Entry &, const AMWatchRecord &record) {
+                records.push_back(record);
+            });
+            return records;
+        }
+
+        /**
+         * \brief Number of calls, that were not watched, because all slots were taken.
+         */
+        static uint64_t untracked() noexcept {
+            return isUsed() ? _AMWatchTable::instance().m_untracked.load(std::memory_order_relaxed) : 0;
+        }
+
+        /**
+         * \brief Writes running calls to file descriptor. Does not allocate nor lock, so it can be called from signal
+         * handler.
+         * @param fd file descriptor, for example STDERR_FILENO
+         * @return number of listed calls
+         */
+        static std::size_t dump(int fd) noexcept {
+            std::size_t count = 0;
+            visit([fd, &count](_AMWatchTable::Entry &, const AMWatchRecord &record) {
+                write(fd, "AMFuture running ");
+                writeNumber(fd, (uint64_t) (record.age.count() / 1000000));
+                write(fd, " ms");
+                if (record.zombie) {
+                    write(fd, " zombie");
+                }
+                write(fd, " at ");
+                write(fd, record.site ? record.site : "?");
+                if (record.line > 0) {
+                    write(fd, ":");
+                    writeNumber(fd, (uint64_t) record.line);
+                }
+                write(fd, "\n");
+                ++count;
+            });
+            uint64_t missed = untracked();
+            if (missed) {
+                write(fd, "AMFuture calls not watched, table was full: ");
+                writeNumber(fd, missed);
+                write(fd, "\n");
+            }
+            return count;
+        }
+
+        /**
+         * \brief constructor
+         * @param threshold calls running longer are reported
+         * @param handler called for every late call once
+         */
+        AMWatchdog(std::chrono::nanoseconds threshold, Handler handler)
+            : m_threshold(threshold), m_handler(std::move(handler))
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+            , m_stop(false)
+#endif
+        {
+            enable();
+        }
+
+        AMWatchdog(const AMWatchdog &other) = delete;
+
+        AMWatchdog &operator=(const AMWatchdog &other) = delete;
+
+        ~AMWatchdog() {
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+            stop();
+#endif
+        }
+
+        /**
+         * \brief Reports calls, that have exceeded threshold since last scan.
+         * @return number of reported calls
+         */
+        std::size_t scan() {
+            std::vector<AMWatchRecord> late;
+            visit([this, &late](_AMWatchTable::Entry &entry, const AMWatchRecord &record) {
+                if (record.age >= m_threshold &&
+                    !(entry.flags.fetch_or(_AMWatchTable::flagReported, std::memory_order_relaxed) & _AMWatchTable::flagReported)) {
+                    late.push_back(record);
+                }
+            });
+            for (const AMWatchRecord &record: late) {
+                m_handler(record);
+            }
+            return late.size();
+        }
+
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+        /**
+         * \brief Starts thread, that calls scan() periodically.
+         * @param period time between scans
+         */
+        void start(std::chrono::milliseconds period) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_thread.joinable()) {
+                return;
+            }
+            m_stop = false;
+            m_thread = std::thread([this, period]() {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                while (!m_wake.wait_for(lock, period, [this]() { return m_stop; })) {
+                    lock.unlock();
+                    scan();
+                    lock.lock();
+                }
+            });
+        }
+
+        /**
+         * \brief Stops the scanning thread.
+         */
+        void stop() {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stop = true;
+            }
+            m_wake.notify_one();
+            if (m_thread.joinable()) {
+                m_thread.join();
+            }
+        }
+#endif
+
+    protected:
+        template<class Visitor>
+        static void visit(Visitor &&visitor) {
+            if (!isUsed()) {
+                return;
+            }
+            _AMWatchTable &table = _AMWatchTable::instance();
+            int64_t now = _AMWatchTable::now();
+            for (_AMWatchTable::Entry &entry: table.m_entries) {
+                int64_t start = entry.start.load(std::memory_order_acquire);
+                if (start == 0) {
+                    continue;
+                }
+                AMWatchRecord record;
+                record.state = entry.owner.load(std::memory_order_relaxed);
+                record.site = entry.site.load(std::memory_order_relaxed);
+                record.line = entry.line.load(std::memory_order_relaxed);
+                record.age = std::chrono::nanoseconds(now - start);
+                record.zombie = (entry.flags.load(std::memory_order_relaxed) & _AMWatchTable::flagZombie) != 0;
+                if (record.state) {
+                    visitor(entry, record);
+                }
+            }
+        }
+
+        /**
+         * \brief Table exists, only if watchdog was enabled. Signal handler must not create it.
+         */
+        static bool isUsed() noexcept {
+            return usedFlag().load(std::memory_order_acquire);
+        }
+
+        static std::atomic<bool> &usedFlag() noexcept {
+            static std::atomic<bool> m_used(false);
+            return m_used;
+        }
+
+        static void write(int fd, const char *text) noexcept {
+            std::size_t length = 0;
+            while (text[length]) {
+                ++length;
+            }
+            while (length > 0) {
+                ssize_t n = ::write(fd, text, length);
+                if (n <= 0) {
+                    return;
+                }
+                text += n;
+                length -= (std::size_t) n;
+            }
+        }
+
+        static void writeNumber(int fd, uint64_t value) noexcept {
+            char buffer[24];
+            char *p = buffer + sizeof(buffer) - 1;
+            *p = 0;
+            do {
+                *--p = (char) ('0' + value % 10);
+                value /= 10;
+            } while (value);
+            write(fd, p);
+        }
+
+        std::chrono::nanoseconds m_threshold;
+        Handler m_handler;
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+        bool m_stop;
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::thread m_thread;
+#endif
+    };
+
+}
+
+#endif //SAW_ALL_AMWATCHDOG_H
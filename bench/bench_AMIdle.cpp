@@ -0,0 +1,98 @@
+//
+// Latency and CPU cost of idle profiles.
+//
+// Main thread launches trivial call on AMThreadPoolExecutor, waits in get() and pauses for a gap. The gap sets
+// arrival rate of calls. For each profile and gap it prints mean and 99th percentile of round trip, CPU time spent
+// per wall time (cores) and number of parks of the workers.
+//
+
+#include "../AMExecutor.h"
+#include <cstdio>
+#include <algorithm>
+#include <sys/resource.h>
+
+using namespace AMCore;
+
+class EchoCall {
+public:
+    int getData(void *mem)
+    {
+        return (int) (intptr_t) mem;
+    }
+
+    bool isDataAvail(void *)
+    {
+        return true;
+    }
+
+    void *prepareData(int parameter)
+    {
+        return (void *) (intptr_t) parameter;
+    }
+};
+
+static double cpuSeconds()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (double) usage.ru_utime.tv_sec + (double) usage.ru_stime.tv_sec +
+           ((double) usage.ru_utime.tv_usec + (double) usage.ru_stime.tv_usec) / 1e6;
+}
+
+static void waitGap(std::chrono::microseconds gap)
+{
+    if (gap.count() == 0) {
+        return;
+    }
+    // sleep, so that the main thread does not add own spinning to CPU time
+    std::this_thread::sleep_for(gap);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned threads = argc > 1 ? (unsigned) std::atoi(argv[1]) : 2;
+    const std::chrono::microseconds gaps[] = {
+        std::chrono::microseconds(0),
+        std::chrono::microseconds(20),
+        std::chrono::microseconds(200),
+        std::chrono::microseconds(2000)
+    };
+    EchoCall echo;
+    std::printf("%-12s %8s %10s %10s %8s %8s\n", "profile", "gap us", "mean us", "p99 us", "cores", "parks");
+    for (AMIdleProfile profile: {AMIdleProfile::lowLatency, AMIdleProfile::powerSaving}) {
+        AMSetIdleProfile(profile);
+        for (std::chrono::microseconds gap: gaps) {
+            AMThreadPoolExecutor executor(threads);
+            int rounds = gap.count() ? (int) std::min<long>(20000, 300000 / gap.count()) : 20000;
+            // warm up, so that the spin window follows the gap
+            for (int i = 0; i < 100; ++i) {
+                AMAsync(executor, &EchoCall::getData, &EchoCall::isDataAvail, &EchoCall::prepareData, echo, i).get();
+                waitGap(gap);
+            }
+            uint64_t parks = executor.parks();
+            std::vector<double> latencies;
+            latencies.reserve((std::size_t) rounds);
+            double cpu = cpuSeconds();
+            auto wall = std::chrono::steady_clock::now();
+            for (int i = 0; i < rounds; ++i) {
+                waitGap(gap);
+                auto start = std::chrono::steady_clock::now();
+                AMAsync(executor, &EchoCall::getData, &EchoCall::isDataAvail, &EchoCall::prepareData, echo, i).get();
+                latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall).count();
+            cpu = cpuSeconds() - cpu;
+            double mean = 0;
+            for (double latency: latencies) {
+                mean += latency;
+            }
+            mean /= (double) latencies.size();
+            std::sort(latencies.begin(), latencies.end());
+            double p99 = latencies[latencies.size() * 99 / 100];
+            std::printf("%-12s %8ld %10.2f %10.2f %8.2f %8lu\n",
+                        profile == AMIdleProfile::lowLatency ? "lowLatency" : "powerSaving", (long) gap.count(), mean,
+                        p99, cpu / seconds, (unsigned long) (executor.parks() - parks));
+        }
+    }
+    return 0;
+}
@@ -13,11 +13,20 @@
  * T getData(prepeareData(U...));
  * \endcode
  *
- * otherwise, **AMAsync** is a wrapper for **std::async**.
+ * **prepareData** is not called inside **AMAsync**, the call is queued. Queue is run by **AMPump()**, or by **get()** of
+ * the future, when its call has not run yet.
+ *
+ * otherwise, **AMAsync** launches the call like **std::async** does. **AMFuture** does not use **std::future**, it has own
+ * lightweight shared state: one atomic word and inline result. Waiting thread spins for a while and then sleeps on futex.
+ * It is not a **std::future** and cannot be passed as **std::future&**. **share()** gives **AMSharedFuture**, that can be
+ * copied and read from more threads, like **std::shared_future**.
  *
  * In emscripten, deleting of std::future causes a crash. As a prevent of it, AMFuture destructor only moves future to backup data structure
  * and threse futures should be released, before program ends. At the finishing of the program, you should call function **checkZombies()** that
  * returns true, if program can be completely destroyed.
+ * 
+ * With many abandoned futures, use **checkZombies(maxItems)** or **checkZombies(deadline)**. They check only part of
+ * futures, continue where the previous call stopped and return number of futures, that are still active.
  *
  * Usage
  * =====
@@ -140,6 +149,223 @@
  *
  * \endcode
  *
+ * Frame loop
+ * ----------
+ *
+ * In singlethreaded build, call **AMPump()** once per frame. It runs queued **AMAsync** calls and releases finished
+ * futures, until time budget is spent. In multithreaded build it only releases finished futures, so the same source works
+ * in both.
+ *
+ * \code
+ *    void frame()
+ *    {
+ *        AMPump(std::chrono::microseconds(2000));
+ *        //render
+ *    }
+ * \endcode
+ *
+ * Waiting for many futures
+ * ------------------------
+ *
+ * Do not poll large set of futures with *wait_for(std::chrono::seconds(0))*. Register them in **AMWaitSet**. Every future
+ * signals the set, when it becomes ready, so waiting costs only O(ready).
+ *
+ * \code
+ *    AMWaitSet set;
+ *    for (AMFuture<int> &f: futures) {
+ *        set.add(f);
+ *    }
+ *    while (set.pending() > 0) {
+ *        for (std::size_t index: set.wait_any()) {
+ *            int res = futures[index].get();
+ *        }
+ *    }
+ * \endcode
+ *
+ * Promise
+ * -------
+ *
+ * When a data source knows itself, that data is ready, let it signal **AMPromise** instead of asking **AvailCallback**
+ * again and again. Future only checks an atomic flag and waiting thread is woken directly.
+ *
+ * \code
+ *    AMPromise<int> promise;
+ *    AMFuture<int> future = promise.get_future();
+ *    //in data source
+ *    promise.set_value(11);
+ * \endcode
+ *
+ * Task graph
+ * ----------
+ *
+ * When some **prepareData** needs results of other calls, declare the calls as **AMTaskGraph**. Node starts as soon as
+ * all its predecessors are finished, so independent branches run in parallel. The graph can be run many times.
+ *
+ * \code
+ *    AMTaskGraph graph;
+ *    AMTaskNode<int> a = graph.add(&Load::getData, &Load::isDataAvail, &Load::prepareData, load, 1);
+ *    AMTaskNode<int> b = graph.add(&Load::getData, &Load::isDataAvail, &Load::prepareData, load, 2);
+ *    AMTaskNode<int> sum = graph.add(&Sum::getData, &Sum::isDataAvail, &Sum::prepareData, s, &graph, a, b);
+ *    graph.precede(a, sum);
+ *    graph.precede(b, sum);
+ *
+ *    graph.run().get();
+ *    int res = graph.result(sum);
+ * \endcode
+ *
+ * Inside **Sum::prepareData**, results of predecessors are available by **graph->result(a)**.
+ *
+ * Deadlines
+ * ---------
+ *
+ * **AMTimerWheel** expires futures at their deadlines. Arming and cancelling a timer costs O(1), so a deadline can be
+ * attached to every call. When the deadline passes before the data are available, **get()** throws **AMFutureTimeout**
+ * and the late result is thrown away.
+ *
+ * \code
+ *    AMTimerWheel wheel;
+ *    wheel.start(); //multithreaded build only, in singlethreaded build call wheel.advance() every frame
+ *    AMTimer timer = wheel.expire(future, std::chrono::steady_clock::now() + std::chrono::milliseconds(50));
+ * \endcode
+ *
+ * Timers with any handler are armed by **wheel.arm(deadline, handler)** and cancelled by **wheel.cancel(timer)**.
+ * In singlethreaded build, **wait_for()** runs queued calls until its duration passes.
+ *
+ * Executors
+ * ---------
+ *
+ * **AMAsync** with **AMLaunch** runs every call on its own thread, or queues it in singlethreaded build. To place
+ * calls elsewhere, pass an executor instead of the policy:
+ *
+ * \code
+ *    AMThreadPoolExecutor pool(4); //multithreaded build only
+ *    AMFuture<int> future = AMAsync(pool, &Test::getData, &Test::isDataAvail, &Test::prepareData, t, 3);
+ * \endcode
+ *
+ * **AMInlineExecutor** runs the call directly in **AMAsync**, the future is ready without any waiting.
+ * **AMManualExecutor** keeps calls, until **run()**, **run_one()** or **run_for(budget)** is called from own loop.
+ * Any class with method **execute(AMTask task)**, that calls **task()** once, is an executor too.
+ *
+ * File reads
+ * ----------
+ *
+ * **AMFileIO** reads local files without a thread per read. On Linux, reads are submitted to io_uring and one thread
+ * collects all completions, elsewhere few worker threads read. In multithreaded build, use **io.read(fd, size, offset)**.
+ * It returns **AMFuture<std::vector<char>>**, that the completion thread fulfils directly:
+ *
+ * \code
+ *    AMFuture<std::vector<char>> block = io.read(fd, 4096, offset);
+ * \endcode
+ *
+ * **prepareRead()** returns the tag, **isDataAvail()** checks it and **getData()** hands over the buffer, that the kernel
+ * has filled. They fit into own callbacks in singlethreaded build, where the frame loop polls isDataAvail. In
+ * multithreaded build, **AMAsync** with these callbacks would block its thread in getData() for every read:
+ *
+ * \code
+ *    void *Block::prepareData(std::uint64_t offset) { return io->prepareRead(fd, 4096, offset); }
+ *    bool Block::isDataAvail(void *tag) { return io->isDataAvail(tag); }
+ *    std::vector<char> Block::getData(void *tag) { return io->getData(tag); }
+ * \endcode
+ *
+ * Link **src/AMFileIO.cpp**.
+ *
+ * Hedged calls
+ * ------------
+ *
+ * When a call is slow only sometimes, **AMAsyncHedged** starts a second attempt with the same parameters, if the first
+ * one has not finished within a delay. The first result wins. The delay is fixed, or a percentile of latency of recent
+ * attempts:
+ *
+ * \code
+ *    AMHedgePolicy policy(0.95, std::chrono::milliseconds(20)); //or AMHedgePolicy policy(std::chrono::milliseconds(20));
+ *    AMFuture<int> future = AMAsyncHedged(policy, &Test::getData, &Test::isDataAvail, &Test::prepareData, t, 3);
+ * \endcode
+ *
+ * The loser is not cancelled in the middle of **prepareData**, it is kept with zombies until it finishes, so
+ * **checkZombies()** still tells, when the application can be destroyed. **policy.hedges()** counts second attempts.
+ *
+ * No thread waits for the delay: second attempts of all calls are armed on one timer of the policy, and a thread
+ * starts only for the attempt, that is really needed. The percentile is computed again after each quarter of window.
+ *
+ * Streams
+ * -------
+ *
+ * When the result is large, the producer can hand it over in parts. **AMAsyncStream** runs producer function
+ * **void produce(AMStreamWriter<T> &out, Args... args)** and the consumer takes items, as they arrive:
+ *
+ * \code
+ *    AMStream<std::vector<char>> stream = AMAsyncStream<std::vector<char>>(8, &Loader::produce, loader, "file");
+ *    for (std::vector<char> &part: stream) {
+ *        //use part
+ *    }
+ * \endcode
+ *
+ * At most **capacity** items wait for the consumer, then **out.push()** waits. When the consumer drops the stream,
+ * **out.push()** returns false and the producer should return. Exception of the producer is thrown after the last
+ * item. In singlethreaded build a function can't be suspended in **out.push()**, so the whole producer runs in the
+ * first **next()** (or **AMPump()**) and all its items are kept. There the stream gives neither earlier first item
+ * nor less memory than **AMAsync** returning a vector, **capacity** is only checked.
+ *
+ * Watchdog
+ * --------
+ *
+ * When **get()** hangs, **AMWatchdog** tells which call is stuck. After **AMWatchdog::enable()**, every launched call
+ * is registered with its start time and call site, until its producer finishes:
+ *
+ * \code
+ *    AMWatchdog watchdog(std::chrono::seconds(5), [](const AMWatchRecord &record) {
+ *        //record.site:record.line has run for record.age
+ *    });
+ *    watchdog.start(std::chrono::seconds(1));
+ *    {
+ *        AMWatchSite site("texture loader");
+ *        AMFuture<int> future = AMAsync(...);
+ *    }
+ * \endcode
+ *
+ * Each call, that runs longer than the threshold, is reported once. Without **AMWatchSite** the site is file and line
+ * of the **AMAsync** call, filled in by the compiler. Calls placed by an executor are named by the type of
+ * prepareData, because the executor type is deduced and the compiler cannot fill in the site.
+ * **AMWatchdog::snapshot()** lists all running calls, zombies included, and **AMWatchdog::dump(fd)** writes them
+ * without locks and allocations, so it can be called from signal handler. Calls are kept in a table of
+ * **AMFUTURE_WATCHDOG_SLOTS** (1024) slots, claimed without locking.
+ *
+ * Batches
+ * -------
+ *
+ * Calls of one request can share an arena. **AMAsync** with **AMBatch** allocates shared states from it, and
+ * prepareData and getData can put tags and results there too, by **batch.resource()**:
+ *
+ * \code
+ *    AMBatch batch;
+ *    AMFuture<std::pmr::vector<char>> future = AMAsync(batch, AMLaunch::async, &Loader::getData,
+ *        &Loader::isDataAvail, &Loader::prepareData, loader, batch.resource());
+ * \endcode
+ *
+ * Memory is taken from the current chunk by compare and swap, so workers don't contend for the global allocator.
+ * Nothing is freed one by one: whole arena goes back to the upstream resource at once, when the batch and all its calls
+ * (zombies included) are gone. Results allocated from the arena must not outlive the batch.
+ *
+ * Only shared states are placed in the arena by the batch itself. Tags and results get there only, when prepareData
+ * and getData allocate them from **batch.resource()**, and **batch.make()** takes only trivially destructible tags,
+ * because nothing in the arena is destroyed. In multithreaded build the thread of each call and heap memory of copied
+ * parameters still come from the global allocator.
+ *
+ * Idle threads
+ * ------------
+ *
+ * Threads waiting in **get()** and idle workers of **AMThreadPoolExecutor** spin with pause, then yield and only then
+ * park on futex. The spin window follows recent waits: when calls come often, threads stay warm, when they are rare,
+ * threads park almost at once. Profile can be switched anytime:
+ *
+ * \code
+ *    AMSetIdleProfile(AMIdleProfile::powerSaving); //short fixed spin, then park
+ *    AMSetIdleProfile(AMIdleProfile::lowLatency);  //adaptive spin and yield, default
+ * \endcode
+ *
+ * On single core machine threads never spin, only yield. Program **BENCH_AMIdle** prints latency, used cores and parks
+ * of both profiles for several gaps between calls.
+ *
  *  For more, see \ref AMFuture.h
  *
  * Sources
@@ -0,0 +1,471 @@
+//
+// Created by zdenek on 18.10.26.
+//
+
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#else
+#include "../AMFileIO.h"
+#include <mutex>
+#include <thread>
+#include <deque>
+#include <condition_variable>
+#include <algorithm>
+#include <cstring>
+#if defined(__linux__)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace AMCore {
+
+    class AMFileIO::Engine {
+    public:
+        explicit Engine(Backend backend)
+            : m_backend(backend) {
+        }
+
+        virtual ~Engine() {
+        }
+
+        /**
+         * \brief Starts the read. Engine holds one reference of state, until the read is finished.
+         */
+        virtual void submit(_AMReadState *state) = 0;
+
+        Backend backend() const noexcept {
+            return m_backend;
+        }
+
+    protected:
+        Backend m_backend;
+    };
+
+    namespace {
+
+        class ThreadEngine : public AMFileIO::Engine {
+        public:
+            explicit ThreadEngine(unsigned threads)
+                : Engine(AMFileIO::Backend::threads), m_stop(false) {
+                for (unsigned i = 0; i < threads; ++i) {
+                    m_threads.emplace_back([this]() {
+                        work();
+                    });
+                }
+            }
+
+            ~ThreadEngine() override {
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_stop = true;
+                }
+                m_wake.notify_all();
+                for (std::thread &thread: m_threads) {
+                    thread.join();
+                }
+            }
+
+            void submit(_AMReadState *state) override {
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_queue.push_back(state);
+                }
+                m_wake.notify_one();
+            }
+
+        protected:
+            void work() {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                for (;;) {
+                    if (!m_queue.empty()) {
+                        _AMReadState *state = m_queue.front();
+                        m_queue.pop_front();
+                        lock.unlock();
+                        state->finish(state->readBlocking());
+                        state->release();
+                        lock.lock();
+                    } else if (m_stop) {
+                        return;
+                    } else {
+                        m_wake.wait(lock);
+                    }
+                }
+            }
+
+            std::deque<_AMReadState *> m_queue;
+            std::mutex m_mutex;
+            std::condition_variable m_wake;
+            bool m_stop;
+            std::vector<std::thread> m_threads;
+        };
+
+#if defined(__linux__)
+
+        class UringEngine : public AMFileIO::Engine {
+        public:
+            UringEngine()
+                : Engine(AMFileIO::Backend::uring), m_ring(-1), m_sqSize(0), m_cqSize(0), m_sqRing(nullptr),
+                  m_cqRing(nullptr), m_sqes(nullptr), m_inflight(0), m_submitted(nullptr), m_broken(0) {
+            }
+
+            ~UringEngine() override {
+                if (m_thread.joinable()) {
+                    Completions failed;
+                    {
+                        std::unique_lock<std::mutex> lock(m_mutex);
+                        m_idle.wait(lock, [this]() {
+                            return m_inflight == 0 && m_backlog.empty();
+                        });
+                        // completion with user_data 0 stops the thread, broken ring has stopped it already
+                        if (m_broken == 0) {
+                            push(nullptr);
+                            flush(failed);
+                        }
+                    }
+                    finish(failed);
+                    m_thread.join();
+                }
+                if (m_sqes) {
+                    munmap(m_sqes, m_params.sq_entries * sizeof(io_uring_sqe));
+                }
+                if (m_cqRing && m_cqRing != m_sqRing) {
+                    munmap(m_cqRing, m_cqSize);
+                }
+                if (m_sqRing) {
+                    munmap(m_sqRing, m_sqSize);
+                }
+                if (m_ring >= 0) {
+                    close(m_ring);
+                }
+            }
+
+            /**
+             * \brief Creates the ring. Fails, where io_uring or its read operation is not available.
+             */
+            bool setup(unsigned depth) {
+                std::memset(&m_params, 0, sizeof(m_params));
+                m_ring = (int) syscall(__NR_io_uring_setup, depth, &m_params);
+                if (m_ring < 0) {
+                    return false;
+                }
+                std::vector<char> probe(sizeof(io_uring_probe) + IORING_OP_LAST * sizeof(io_uring_probe_op), 0);
+                io_uring_probe *p = reinterpret_cast<io_uring_probe *>(probe.data());
+                if (syscall(__NR_io_uring_register, m_ring, IORING_REGISTER_PROBE, p, IORING_OP_LAST) < 0 ||
+                    p->last_op < IORING_OP_READ || !(p->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED)) {
+                    return false;
+                }
+                m_sqSize = m_params.sq_off.array + m_params.sq_entries * sizeof(unsigned);
+                m_cqSize = m_params.cq_off.cqes + m_params.cq_entries * sizeof(io_uring_cqe);
+                if (m_params.features & IORING_FEAT_SINGLE_MMAP) {
+                    m_sqSize = m_cqSize = std::max(m_sqSize, m_cqSize);
+                }
+                m_sqRing = map(m_sqSize, IORING_OFF_SQ_RING);
+                if (!m_sqRing) {
+                    return false;
+                }
+                m_cqRing = (m_params.features & IORING_FEAT_SINGLE_MMAP) ? m_sqRing : map(m_cqSize, IORING_OFF_CQ_RING);
+                if (!m_cqRing) {
+                    return false;
+                }
+                m_sqes = static_cast<io_uring_sqe *>(map(m_params.sq_entries * sizeof(io_uring_sqe), IORING_OFF_SQES));
+                if (!m_sqes) {
+                    return false;
+                }
+                m_thread = std::thread([this]() {
+                    reap();
+                });
+                return true;
+            }
+
+            void submit(_AMReadState *state) override {
+                Completions failed;
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    if (m_broken != 0) {
+                        failed.emplace_back(state, m_broken);
+                    } else if (m_inflight < m_params.sq_entries) {
+                        push(state);
+                        flush(failed);
+                    } else {
+                        m_backlog.push_back(state);
+                    }
+                }
+                finish(failed);
+            }
+
+        protected:
+            typedef std::vector<std::pair<_AMReadState *, long>> Completions;
+
+            void *map(std::size_t size, off_t offset) {
+                void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring, offset);
+                return p == MAP_FAILED ? nullptr : p;
+            }
+
+            unsigned *sq(unsigned offset) {
+                return reinterpret_cast<unsigned *>(static_cast<char *>(m_sqRing) + offset);
+            }
+
+            unsigned *cq(unsigned offset) {
+                return reinterpret_cast<unsigned *>(static_cast<char *>(m_cqRing) + offset);
+            }
+
+            /**
+             * \brief Puts read into submission queue. Called with m_mutex locked.
+             */
+            void push(_AMReadState *state) {
+                unsigned tail = *sq(m_params.sq_off.tail);
+                unsigned index = tail & *sq(m_params.sq_off.ring_mask);
+                io_uring_sqe &sqe = m_sqes[index];
+                std::memset(&sqe, 0, sizeof(sqe));
+                if (state) {
+                    sqe.opcode = IORING_OP_READ;
+                    sqe.fd = state->m_fd;
+                    // short read goes on, where the previous part ended
+                    sqe.addr = reinterpret_cast<uint64_t>(state->m_buffer.data() + state->m_done);
+                    sqe.len = (uint32_t) (state->m_buffer.size() - state->m_done);
+                    sqe.off = state->m_offset + state->m_done;
+                    ++m_inflight;
+                    link(state);
+                } else {
+                    sqe.opcode = IORING_OP_NOP;
+                }
+                sqe.user_data = reinterpret_cast<uint64_t>(state);
+                sq(m_params.sq_off.array)[index] = index;
+                __atomic_store_n(sq(m_params.sq_off.tail), tail + 1, __ATOMIC_RELEASE);
+            }
+
+            void link(_AMReadState *state) {
+                state->m_previous = nullptr;
+                state->m_next = m_submitted;
+                if (m_submitted) {
+                    m_submitted->m_previous = state;
+                }
+                m_submitted = state;
+            }
+
+            void unlink(_AMReadState *state) {
+                if (state->m_previous) {
+                    state->m_previous->m_next = state->m_next;
+                } else {
+                    m_submitted = state->m_next;
+                }
+                if (state->m_next) {
+                    state->m_next->m_previous = state->m_previous;
+                }
+            }
+
+            /**
+             * \brief Submits all entries, that the kernel has not taken yet. Called with m_mutex locked.
+             *
+             * Kernel short of resources leaves the rest in the queue, reap() submits it before it waits. Other errors
+             * take the entries back and their reads fail.
+             * @param failed reads, that could not be submitted
+             */
+            void flush(Completions &failed) {
+                for (;;) {
+                    unsigned head = __atomic_load_n(sq(m_params.sq_off.head), __ATOMIC_ACQUIRE);
+                    unsigned tail = *sq(m_params.sq_off.tail);
+                    if (head == tail) {
+                        return;
+                    }
+                    int r = enter(tail - head, 0, 0);
+                    if (r > 0) {
+                        continue;
+                    }
+                    if (r == 0 || errno == EAGAIN || errno == EBUSY) {
+                        return;
+                    }
+                    long error = -errno;
+                    // reap() may have submitted some entries meanwhile
+                    head = __atomic_load_n(sq(m_params.sq_off.head), __ATOMIC_ACQUIRE);
+                    unsigned mask = *sq(m_params.sq_off.ring_mask);
+                    for (unsigned i = head; i != tail; ++i) {
+                        _AMReadState *state = reinterpret_cast<_AMReadState *>(m_sqes[sq(m_params.sq_off.array)[i & mask]].user_data);
+                        if (state) {
+                            --m_inflight;
+                            unlink(state);
+                            failed.emplace_back(state, error);
+                        }
+                    }
+                    __atomic_store_n(sq(m_params.sq_off.tail), head, __ATOMIC_RELEASE);
+                    return;
+                }
+            }
+
+            static void finish(const Completions &done) {
+                for (const std::pair<_AMReadState *, long> &d: done) {
+                    d.first->finish(d.second);
+                    d.first->release();
+                }
+            }
+
+            int enter(unsigned toSubmit, unsigned minComplete, unsigned flags) {
+                int r;
+                do {
+                    r = (int) syscall(__NR_io_uring_enter, m_ring, toSubmit, minComplete, flags, nullptr, 0);
+                } while (r < 0 && errno == EINTR);
+                return r;
+            }
+
+            /**
+             * \brief Submits the rest of reads, that io_uring has finished short before the end of file. Called with
+             * m_mutex locked.
+             *
+             * Only 0 tells the end of file, so the rest is asked again at its own offset. Finished reads stay in done,
+             * with their whole length.
+             */
+            void resubmitShort(Completions &done) {
+                std::size_t kept = 0;
+                for (const std::pair<_AMReadState *, long> &d: done) {
+                    _AMReadState *state = d.first;
+                    if (d.second > 0 && state->m_done + (std::size_t) d.second < state->m_buffer.size()) {
+                        state->m_done += (std::size_t) d.second;
+                        push(state);
+                    } else {
+                        done[kept++] = std::make_pair(state, d.second < 0 ? d.second : (long) (state->m_done + (std::size_t) d.second));
+                    }
+                }
+                done.resize(kept);
+            }
+
+            /**
+             * \brief Fails all reads, after the ring has stopped working. Later reads fail in submit().
+             */
+            void breakRing(long error) {
+                Completions failed;
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_broken = error;
+                    for (_AMReadState *state = m_submitted; state; state = state->m_next) {
+                        failed.emplace_back(state, error);
+                    }
+                    for (_AMReadState *state: m_backlog) {
+                        failed.emplace_back(state, error);
+                    }
+                    m_submitted = nullptr;
+                    m_backlog.clear();
+                    m_inflight = 0;
+                    __atomic_store_n(sq(m_params.sq_off.tail), __atomic_load_n(sq(m_params.sq_off.head), __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+                    m_idle.notify_all();
+                }
+                finish(failed);
+            }
+
+            void reap() {
+                Completions done;
+                for (;;) {
+                    // entries, that flush() has left to the kernel short of resources, are submitted again
+                    unsigned toSubmit = __atomic_load_n(sq(m_params.sq_off.tail), __ATOMIC_ACQUIRE) -
+                        __atomic_load_n(sq(m_params.sq_off.head), __ATOMIC_ACQUIRE);
+                    int r = enter(toSubmit, 1, IORING_ENTER_GETEVENTS);
+                    if (r < 0 && errno != EAGAIN && errno != EBUSY) {
+                        breakRing(-errno);
+                        return;
+                    }
+                    unsigned head = *cq(m_params.cq_off.head);
+                    unsigned tail = __atomic_load_n(cq(m_params.cq_off.tail), __ATOMIC_ACQUIRE);
+                    unsigned mask = *cq(m_params.cq_off.ring_mask);
+                    io_uring_cqe *cqes = reinterpret_cast<io_uring_cqe *>(static_cast<char *>(m_cqRing) + m_params.cq_off.cqes);
+                    bool stop = false;
+                    done.clear();
+                    for (; head != tail; ++head) {
+                        io_uring_cqe &cqe = cqes[head & mask];
+                        _AMReadState *state = reinterpret_cast<_AMReadState *>(cqe.user_data);
+                        if (state) {
+                            done.emplace_back(state, (long) cqe.res);
+                        } else {
+                            stop = true;
+                        }
+                    }
+                    __atomic_store_n(cq(m_params.cq_off.head), head, __ATOMIC_RELEASE);
+                    if (r < 0 && done.empty() && !stop) {
+                        // kernel is short of resources and nothing has completed, do not spin
+                        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    }
+                    if (!done.empty()) {
+                        Completions failed;
+                        {
+                            // the lock also orders this thread after the submitters, the kernel does not
+                            std::lock_guard<std::mutex> lock(m_mutex);
+                            m_inflight -= (unsigned) done.size();
+                            for (const std::pair<_AMReadState *, long> &d: done) {
+                                unlink(d.first);
+                            }
+                            resubmitShort(done);
+                            while (!m_backlog.empty() && m_inflight < m_params.sq_entries) {
+                                push(m_backlog.front());
+                                m_backlog.pop_front();
+                            }
+                            flush(failed);
+                            if (m_inflight == 0 && m_backlog.empty()) {
+                                m_idle.notify_all();
+                            }
+                        }
+                        finish(done);
+                        finish(failed);
+                    }
+                    if (stop) {
+                        return;
+                    }
+                }
+            }
+
+            int m_ring;
+            io_uring_params m_params;
+            std::size_t m_sqSize;
+            std::size_t m_cqSize;
+            void *m_sqRing;
+            void *m_cqRing;
+            io_uring_sqe *m_sqes;
+            unsigned m_inflight;
+            _AMReadState *m_submitted;
+            long m_broken;
+            std::deque<_AMReadState *> m_backlog;
+            std::mutex m_mutex;
+            std::condition_variable m_idle;
+            std::thread m_thread;
+        };
+
+#endif
+
+    }
+
+    AMFileIO::AMFileIO(unsigned depth, Backend backend)
+        : m_engine(nullptr) {
+        assert(depth > 0);
+#if defined(__linux__)
+        if (backend == Backend::automatic || backend == Backend::uring) {
+            UringEngine *engine = new UringEngine();
+            if (engine->setup(depth)) {
+                m_engine = engine;
+                return;
+            }
+            delete engine;
+        }
+#else
+        (void) backend;
+#endif
+        m_engine = new ThreadEngine(std::min(depth, 4u));
+    }
+
+    AMFileIO::~AMFileIO() {
+        delete m_engine;
+    }
+
+    AMFileIO::Backend AMFileIO::backend() const noexcept {
+        return m_engine->backend();
+    }
+
+    void AMFileIO::submit(_AMReadState *state) {
+        state->addRef();
+        try {
+            m_engine->submit(state);
+        } catch (...) {
+            state->release();
+            state->release();
+            throw;
+        }
+    }
+
+}
+#endif
@@ -6,41 +6,135 @@
 #else
 #include "../AMFuture.h"
 #include <set>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <climits>
+#include <ctime>
+#else
+#include <condition_variable>
+#endif
 
 namespace AMCore {
 
+#if defined(__linux__)
+
+    void _AMParker::wait(std::atomic<uint32_t> &word, uint32_t expected, const std::chrono::nanoseconds *timeout) {
+        struct timespec ts;
+        if (timeout) {
+            ts.tv_sec = (time_t)(timeout->count() / 1000000000);
+            ts.tv_nsec = (long)(timeout->count() % 1000000000);
+        }
+        syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAIT_PRIVATE, expected, timeout ? &ts : nullptr, nullptr, 0);
+    }
+
+    void _AMParker::wakeAll(std::atomic<uint32_t> &word) {
+        syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+    }
+
+    void _AMParker::wakeOne(std::atomic<uint32_t> &word) {
+        syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+    }
+
+#else
+
+    namespace {
+        struct ParkerBucket {
+            std::mutex mutex;
+            std::condition_variable cv;
+        };
+
+        ParkerBucket &parkerBucket(std::atomic<uint32_t> &word) {
+            static ParkerBucket buckets[64];
+            return buckets[(reinterpret_cast<uintptr_t>(&word) >> 4) % 64];
+        }
+    }
+
+    void _AMParker::wait(std::atomic<uint32_t> &word, uint32_t expected, const std::chrono::nanoseconds *timeout) {
+        ParkerBucket &b = parkerBucket(word);
+        std::unique_lock<std::mutex> lock(b.mutex);
+        if (word.load(std::memory_order_acquire) != expected) {
+            return;
+        }
+        if (timeout) {
+            b.cv.wait_for(lock, *timeout);
+        } else {
+            b.cv.wait(lock);
+        }
+    }
+
+    void _AMParker::wakeAll(std::atomic<uint32_t> &word) {
+        ParkerBucket &b = parkerBucket(word);
+        {
+            std::lock_guard<std::mutex> lock(b.mutex);
+        }
+        b.cv.notify_all();
+    }
+
+    void _AMParker::wakeOne(std::atomic<uint32_t> &word) {
+        // bucket is shared by more words, waking only one thread could miss the right one
+        wakeAll(word);
+    }
+
+#endif
+
     std::set<_AMFutureZombieBase *> _AMFutureZombieBase::m_zombies;
+    _AMFutureZombieBase *_AMFutureZombieBase::m_cursor = nullptr;
+    std::mutex _AMFutureZombieBase::m_mutex;
 
     bool _AMFutureZombieBase::checkZombies() {
-        if (m_zombies.size() > 0) {
-            for (std::set<_AMFutureZombieBase *>::iterator it = m_zombies.begin(); it != m_zombies.end();) {
-                if ((*it)->valid()) {
-                    if ((*it)->ready()) {
-                        (*it)->get();
-                        _AMFutureZombieBase *p = *it;
-                        it = m_zombies.erase(it);
-                        delete p;
-                        //printf("Mazu AMFuture zombie, zbývá %li\n", m_zombies.size());
-                        if (it == m_zombies.end()) {
-                            break;
-                        }
-                    }
-                } else {
-                    _AMFutureZombieBase *p = (*it);
+        return reap(SIZE_MAX, nullptr) == 0;
+    }
+
+    std::size_t _AMFutureZombieBase::checkZombies(std::size_t maxItems) {
+        return reap(maxItems, nullptr);
+    }
+
+    std::size_t _AMFutureZombieBase::checkZombies(std::chrono::steady_clock::time_point deadline) {
+        return reap(SIZE_MAX, &deadline);
+    }
+
+    std::size_t _AMFutureZombieBase::reap(std::size_t maxItems, const std::chrono::steady_clock::time_point *deadline) {
+        std::vector<_AMFutureZombieBase *> dead;
+        std::size_t left;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            std::size_t count = std::min(maxItems, m_zombies.size());
+            std::set<_AMFutureZombieBase *>::iterator it = m_zombies.upper_bound(m_cursor);
+            for (std::size_t n = 0; n < count; ++n) {
+                if (it == m_zombies.end()) {
+                    it = m_zombies.begin();
+                }
+                m_cursor = *it;
+                if (!(*it)->valid() || (*it)->ready()) {
+                    dead.push_back(*it);
                     it = m_zombies.erase(it);
-                    delete p;
-                    //printf("Mazu neval zombie, zbývá %li\n", m_zombies.size());
-                    if (it == m_zombies.end()) {
-                        break;
-                    }
+                } else {
+                    ++it;
+                }
+                if (deadline && std::chrono::steady_clock::now() >= *deadline) {
+                    break;
                 }
             }
-            return m_zombies.size() == 0;
+            left = m_zombies.size();
+        }
+        // released outside of the lock, destructors may create new zombies
+        for (_AMFutureZombieBase *p: dead) {
+            if (p->valid()) {
+                p->get();
+            }
+            delete p;
         }
-        return true;
+        return left;
     }
 
     void _AMFutureZombieBase::add(_AMFutureZombieBase *p) {
+        std::lock_guard<std::mutex> lock(m_mutex);
         m_zombies.insert(p);
     };
 
@@ -49,4 +143,4 @@ namespace AMCore {
     }
 
 }
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,170 @@
+#include "../../AMBatch.h"
+#include "gtest/gtest.h"
+#include <thread>
+
+using namespace AMCore;
+
+/**
+ * Upstream resource, that counts outstanding allocations.
+ */
+class CountingResource : public std::pmr::memory_resource {
+public:
+    std::atomic<int> allocations{0};
+    std::atomic<int> outstanding{0};
+
+protected:
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        ++allocations;
+        ++outstanding;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void *p, std::size_t bytes, std::size_t alignment) override
+    {
+        --outstanding;
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+    {
+        return this == &other;
+    }
+};
+
+/**
+ * Tag and result are allocated from arena of the batch.
+ */
+class ArenaTest {
+public:
+    struct Tag {
+        int parameter;
+        std::pmr::memory_resource *resource;
+    };
+
+    std::pmr::vector<int> getData(void *mem)
+    {
+        Tag *tag = static_cast<Tag *>(mem);
+        return std::pmr::vector<int>((std::size_t) tag->parameter, tag->parameter, tag->resource);
+    }
+
+    bool isDataAvail(void *)
+    {
+        return true;
+    }
+
+    void *prepareData(int parameter, std::pmr::memory_resource *resource)
+    {
+        return new(resource->allocate(sizeof(Tag), alignof(Tag))) Tag{parameter, resource};
+    }
+};
+
+TEST(AMBatch, fanOut)
+{
+    CountingResource upstream;
+    std::vector<AMFuture<std::pmr::vector<int>>> futures;
+    {
+        AMBatch batch(4096, &upstream);
+        ArenaTest t;
+        for (int i = 1; i <= 200; ++i) {
+            futures.push_back(AMAsync(batch, AMLaunch::async, &ArenaTest::getData, &ArenaTest::isDataAvail, &ArenaTest::prepareData, t, i, batch.resource()));
+        }
+        for (int i = 1; i <= 200; ++i) {
+            std::pmr::vector<int> result = futures[i - 1].get();
+            ASSERT_EQ(result.size(), (std::size_t) i);
+            EXPECT_EQ(result[0], i);
+            EXPECT_EQ(result.get_allocator().resource(), batch.resource());
+        }
+        EXPECT_GE(batch.reserved(), 200 * sizeof(int) * 100u);
+    }
+    // few chunks instead of allocation per state, tag and result
+    EXPECT_LT(upstream.allocations, 20);
+    // workers release the last states
+    while (upstream.outstanding != 0) {
+        std::this_thread::yield();
+    }
+}
+
+TEST(AMBatch, outlivedByZombie)
+{
+    CountingResource upstream;
+    std::atomic<bool> release(false);
+    struct SlowTest {
+        std::atomic<bool> *release;
+
+        int getData(void *mem)
+        {
+            return (int) (intptr_t) mem;
+        }
+
+        bool isDataAvail(void *)
+        {
+            return true;
+        }
+
+        void *prepareData(int parameter)
+        {
+            while (!*release) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            return (void *) (intptr_t) parameter;
+        }
+    } t{&release};
+    {
+        AMBatch batch(1024, &upstream);
+        AMFuture<int> future = AMAsync(batch, AMLaunch::async, &SlowTest::getData, &SlowTest::isDataAvail, &SlowTest::prepareData, t, 5);
+        EXPECT_EQ(batch.pending(), 1u);
+        AMFuture<int> deferred = AMAsync(batch, AMLaunch::deferred, &SlowTest::getData, &SlowTest::isDataAvail, &SlowTest::prepareData, t, 6);
+        EXPECT_EQ(batch.pending(), 2u);
+    }
+    // the running call keeps the arena
+    EXPECT_EQ(upstream.outstanding, 1);
+    release = true;
+    while (!checkZombies()) {
+        std::this_thread::yield();
+    }
+    while (upstream.outstanding != 0) {
+        std::this_thread::yield();
+    }
+}
+
+TEST(AMBatch, futuresOutliveBatch)
+{
+    CountingResource upstream;
+    struct SquareTest {
+        int getData(void *mem)
+        {
+            return (int) (intptr_t) mem;
+        }
+
+        bool isDataAvail(void *)
+        {
+            return true;
+        }
+
+        void *prepareData(int parameter)
+        {
+            return (void *) (intptr_t) (parameter * parameter);
+        }
+    } t;
+    std::vector<AMFuture<int>> futures;
+    {
+        AMBatch batch(1024, &upstream);
+        for (int i = 0; i < 10; ++i) {
+            futures.push_back(AMAsync(batch, AMLaunch::deferred, &SquareTest::getData, &SquareTest::isDataAvail, &SquareTest::prepareData, t, i));
+        }
+    }
+    // futures keep the arena, after the batch is gone
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_GT(upstream.outstanding, 0);
+        EXPECT_EQ(futures[i].get(), i * i);
+    }
+    // the last state has released the arena
+    EXPECT_EQ(upstream.outstanding, 0);
+}
+
+int main(int argc, char **argv) {
+
+     ::testing::InitGoogleTest(&argc, argv);
+     return RUN_ALL_TESTS();
+}
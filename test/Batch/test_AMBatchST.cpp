@@ -0,0 +1,107 @@
+#define __EMSCRIPTEN__
+
+#include "../../AMBatch.h"
+#include "gtest/gtest.h"
+
+using namespace AMCore;
+
+/**
+ * Upstream resource, that counts outstanding allocations.
+ */
+class CountingResource : public std::pmr::memory_resource {
+public:
+    int allocations = 0;
+    int outstanding = 0;
+
+protected:
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        ++allocations;
+        ++outstanding;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void *p, std::size_t bytes, std::size_t alignment) override
+    {
+        --outstanding;
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+    {
+        return this == &other;
+    }
+};
+
+/**
+ * Tags are allocated from the batch, data are available, when the test says so.
+ */
+class ArenaTest {
+public:
+    struct Tag {
+        int parameter;
+    };
+
+    AMBatch *batch;
+    bool avail;
+
+    int getData(void *mem)
+    {
+        return static_cast<Tag *>(mem)->parameter;
+    }
+
+    bool isDataAvail(void *)
+    {
+        return avail;
+    }
+
+    void *prepareData(int parameter)
+    {
+        return batch->make<Tag>(Tag{parameter});
+    }
+};
+
+TEST(AMBatch, fanOut)
+{
+    CountingResource upstream;
+    {
+        AMBatch batch(4096, &upstream);
+        ArenaTest t{&batch, true};
+        std::vector<AMFuture<int>> futures;
+        for (int i = 0; i < 100; ++i) {
+            futures.push_back(AMAsync(batch, AMLaunch::async, &ArenaTest::getData, &ArenaTest::isDataAvail, &ArenaTest::prepareData, t, i));
+        }
+        EXPECT_EQ(batch.pending(), 100u);
+        for (int i = 0; i < 100; ++i) {
+            EXPECT_EQ(futures[i].get(), i);
+        }
+        // run queue holds the calls, until it is pumped
+        AMPump(std::chrono::milliseconds(10));
+        EXPECT_EQ(batch.pending(), 0u);
+        EXPECT_LT(upstream.allocations, 5);
+    }
+    EXPECT_EQ(upstream.outstanding, 0);
+}
+
+TEST(AMBatch, outlivedByZombie)
+{
+    CountingResource upstream;
+    AMBatch *batch = new AMBatch(1024, &upstream);
+    ArenaTest t{batch, false};
+    {
+        AMFuture<int> future = AMAsync(*batch, AMLaunch::async, &ArenaTest::getData, &ArenaTest::isDataAvail, &ArenaTest::prepareData, t, 1);
+        EXPECT_EQ(future.wait_for(std::chrono::milliseconds(1)), AMFutureStatus::timeout);
+    }
+    delete batch;
+    // the zombie keeps the arena
+    EXPECT_EQ(upstream.outstanding, 1);
+    t.avail = true;
+    EXPECT_TRUE(checkZombies());
+    EXPECT_EQ(upstream.outstanding, 0);
+}
+
+int main(int argc, char **argv) {
+
+     ::testing::InitGoogleTest(&argc, argv);
+     return RUN_ALL_TESTS();
+}
@@ -0,0 +1,157 @@
+#include "../../AMExecutor.h"
+#include "gtest/gtest.h"
+#include <set>
+
+using namespace AMCore;
+
+class SquareTest {
+public:
+    std::atomic<int> *calls;
+
+    int getData(void *mem)
+    {
+        int value = (int) (intptr_t) mem;
+        if (value < 0) {
+            throw std::runtime_error("negative");
+        }
+        return value * value;
+    }
+
+    bool isDataAvail(void *mem)
+    {
+        return true;
+    }
+
+    void *prepareData(int parameter)
+    {
+        ++*calls;
+        return (void *) (intptr_t) parameter;
+    }
+};
+
+/**
+ * Executor of own event loop.
+ */
+class LoopExecutor {
+public:
+    std::vector<AMTask> tasks;
+
+    void execute(AMTask task)
+    {
+        tasks.push_back(std::move(task));
+    }
+};
+
+TEST(AMExecutor, inlineExecutor)
+{
+    std::atomic<int> calls(0);
+    SquareTest s{&calls};
+    AMInlineExecutor executor;
+    AMFuture<int> future = AMAsync(executor, &SquareTest::getData, &SquareTest::isDataAvail, &SquareTest::prepareData, s, 3);
+    EXPECT_EQ(calls, 1);
+    EXPECT_EQ(future.wait_for(std::chrono::seconds(0)), AMFutureStatus::ready);
+    EXPECT_EQ(future.get(), 9);
+
+    AMFuture<int> failed = AMAsync(executor, &SquareTest::getData, &SquareTest::isDataAvail, &SquareTest::prepareData, s, -1);
+    EXPECT_THROW(failed.get(), std::runtime_error);
+}
+
+TEST(AMExecutor, threadPool)
+{
+    std::atomic<int> calls(0);
+    SquareTest s{&calls};
+    std::vector<AMFuture<int>> futures;
+    {
+        AMThreadPoolExecutor executor(4);
+        EXPECT_EQ(executor.size(), 4u);
+        for (int i = 0; i < 1000; ++i) {
+            futures.push_back(AMAsync(executor, &SquareTest::getData, &SquareTest::isDataAvail, &SquareTest::prepareData, s, i));
+        }
+        EXPECT_EQ(futures[10].get(), 100);
+        for (int i = 0; i < 10; ++i) {
+            futures.pop_back();
+        }
+    }
+    EXPECT_EQ(calls, 1000);
+    for (std::size_t i = 11; i < futures.size(); ++i) {
+        EXPECT_EQ(futures[i].get(), (int) (i * i));
+    }
+    EXPECT_TRUE(checkZombies());
+}
+
+TEST(AMExecutor, idleProfiles)
+{
+    std::atomic<int> calls(0);
+    SquareTest s{&calls};
+    AMThreadPoolExecutor executor(2);
+    for (AMIdleProfile profile: {AMIdleProfile::powerSaving, AMIdleProfile::lowLatency}) {
+        AMSetIdleProfile(profile);
+        EXPECT_EQ(AMGetIdleProfile(), profile);
+        // back to back calls and calls after long pauses
+        for (int i = 0; i < 200; ++i) {
+            EXPECT_EQ(AMAsync(executor, &SquareTest::getData, &SquareTest::isDataAvail, &SquareTest::prepareData, s, i).get(), i * i);
+        }
+        uint64_t parks = executor.parks();
+        for (int i = 0; i < 20; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            EXPECT_EQ(AMAsync(executor, &SquareTest::getData, &SquareTest::isDataAvail, &SquareTest::prepareData, s, i).get(), i * i);
+        }
+        // rare calls are not worth spinning, idle workers sleep
+        EXPECT_GT(executor.parks(), parks);
+    }
+
+    // many producers, while the profile changes
+    std::vector<std::thread> producers;
+    std::atomic<int> sum(0);
+    for (int p = 0; p < 4; ++p) {
+        producers.emplace_back([&executor, &s, &sum]() {
+            for (int i = 0; i < 2000; ++i) {
+                sum += AMAsync(executor, &SquareTest::getData, &SquareTest::isDataAvail, &SquareTest::prepareData, s, 1).get();
+            }
+        });
+    }
+    for (int i = 0; i < 20; ++i) {
+        AMSetIdleProfile(i % 2 ? AMIdleProfile::lowLatency : AMIdleProfile::powerSaving);
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+    for (std::thread &producer: producers) {
+        producer.join();
+    }
+    EXPECT_EQ(sum, 8000);
+    AMSetIdleProfile(AMIdleProfile::lowLatency);
+}
+
+TEST(AMExecutor, manualExecutor)
+{
+    std::atomic<int> calls(0);
+    SquareTest s{&calls};
+    AMManualExecutor executor;
+    AMFuture<int> a = AMAsync(executor, &SquareTest::getData, &SquareTest::isDataAvail, &SquareTest::prepareData, s, 2);
+    AMFuture<int> b = AMAsync(executor, &SquareTest::getData, &SquareTest::isDataAvail, &SquareTest::prepareData, s, 4);
+    EXPECT_EQ(executor.size(), 2u);
+    EXPECT_EQ(a.wait_for(std::chrono::milliseconds(1)), AMFutureStatus::timeout);
+    EXPECT_TRUE(executor.run_one());
+    EXPECT_EQ(a.get(), 4);
+    EXPECT_EQ(b.wait_for(std::chrono::seconds(0)), AMFutureStatus::timeout);
+
+    std::thread loop([&executor]() {
+        executor.run_for(std::chrono::seconds(1));
+    });
+    EXPECT_EQ(b.get(), 16);
+    loop.join();
+    EXPECT_EQ(executor.run(), 0u);
+
+    LoopExecutor own;
+    AMFuture<int> c = AMAsync(own, &SquareTest::getData, &SquareTest::isDataAvail, &SquareTest::prepareData, s, 5);
+    ASSERT_EQ(own.tasks.size(), 1u);
+    own.tasks[0]();
+    EXPECT_FALSE(own.tasks[0]);
+    EXPECT_EQ(c.get(), 25);
+    EXPECT_EQ(calls, 3);
+}
+
+int main(int argc, char **argv) {
+
+     ::testing::InitGoogleTest(&argc, argv);
+     return RUN_ALL_TESTS();
+}
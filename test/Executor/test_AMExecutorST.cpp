@@ -0,0 +1,72 @@
+#define __EMSCRIPTEN__
+
+#include "../../AMExecutor.h"
+#include "gtest/gtest.h"
+
+using namespace AMCore;
+
+class SquareTest {
+public:
+    int *calls;
+    int *polls;
+    int delay;
+
+    int getData(void *mem)
+    {
+        int value = (int) (intptr_t) mem;
+        return value * value;
+    }
+
+    bool isDataAvail(void *mem)
+    {
+        return ++*polls > delay;
+    }
+
+    void *prepareData(int parameter)
+    {
+        ++*calls;
+        *polls = 0;
+        return (void *) (intptr_t) parameter;
+    }
+};
+
+TEST(AMExecutor, inlineExecutor)
+{
+    int calls = 0, polls = 0;
+    SquareTest s{&calls, &polls, 1};
+    AMInlineExecutor executor;
+    AMFuture<int> future = AMAsync(executor, &SquareTest::getData, &SquareTest::isDataAvail, &SquareTest::prepareData, s, 3);
+    EXPECT_EQ(calls, 1);
+    EXPECT_FALSE(future.valid());
+    EXPECT_TRUE(future.valid());
+    EXPECT_EQ(future.get(), 9);
+}
+
+TEST(AMExecutor, manualExecutor)
+{
+    int calls = 0, polls = 0;
+    SquareTest s{&calls, &polls, 1};
+    AMManualExecutor executor;
+    AMFuture<int> a = AMAsync(executor, &SquareTest::getData, &SquareTest::isDataAvail, &SquareTest::prepareData, s, 2);
+    EXPECT_EQ(executor.size(), 1u);
+    EXPECT_EQ(calls, 0);
+    EXPECT_EQ(executor.run_for(std::chrono::microseconds(0)), 1u);
+    EXPECT_EQ(calls, 1);
+    while (!a.valid()) {
+    }
+    EXPECT_EQ(a.get(), 4);
+
+    // get() does not wait for the loop, which runs on the same thread
+    SquareTest now{&calls, &polls, 0};
+    AMFuture<int> b = AMAsync(executor, &SquareTest::getData, &SquareTest::isDataAvail, &SquareTest::prepareData, now, 4);
+    EXPECT_EQ(b.get(), 16);
+    EXPECT_EQ(executor.run(), 1u);
+    EXPECT_EQ(calls, 2);
+    EXPECT_TRUE(checkZombies());
+}
+
+int main(int argc, char **argv) {
+
+     ::testing::InitGoogleTest(&argc, argv);
+     return RUN_ALL_TESTS();
+}
@@ -0,0 +1,109 @@
+#include "../../AMFileIO.h"
+#include "gtest/gtest.h"
+#include <fcntl.h>
+#include <cstdlib>
+#include <string>
+
+using namespace AMCore;
+
+/**
+ * Local file with bytes 0, 1, 2, ... 255, 0, 1, ...
+ */
+class TestFile {
+public:
+    TestFile(std::size_t size)
+    {
+        char name[] = "/tmp/AMFileIOXXXXXX";
+        fd = mkstemp(name);
+        unlink(name);
+        std::vector<char> data(size);
+        for (std::size_t i = 0; i < size; ++i) {
+            data[i] = (char) i;
+        }
+        EXPECT_EQ(write(fd, data.data(), size), (ssize_t) size);
+    }
+
+    ~TestFile()
+    {
+        close(fd);
+    }
+
+    int fd;
+};
+
+class Block {
+public:
+    AMFileIO *io;
+    int fd;
+
+    std::vector<char> getData(void *tag)
+    {
+        return io->getData(tag);
+    }
+
+    bool isDataAvail(void *tag)
+    {
+        return io->isDataAvail(tag);
+    }
+
+    void *prepareData(std::uint64_t offset)
+    {
+        return io->prepareRead(fd, 4096, offset);
+    }
+};
+
+static bool checkBytes(const std::vector<char> &data, std::uint64_t offset)
+{
+    for (std::size_t i = 0; i < data.size(); ++i) {
+        if (data[i] != (char) (offset + i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void readMany(AMFileIO::Backend backend)
+{
+    TestFile file(1 << 20);
+    AMFileIO io(8, backend);
+    if (backend != AMFileIO::Backend::automatic) {
+        EXPECT_EQ(io.backend(), backend);
+    }
+
+    // more reads than depth, all driven by one thread
+    std::vector<AMFuture<std::vector<char>>> futures;
+    for (std::uint64_t offset = 0; offset < (1 << 20); offset += 4096) {
+        futures.push_back(io.read(file.fd, 4096, offset + 1));
+    }
+    for (std::size_t i = 0; i < futures.size(); ++i) {
+        std::vector<char> data = futures[i].get();
+        EXPECT_EQ(data.size(), i + 1 < futures.size() ? 4096u : 4095u);
+        EXPECT_TRUE(checkBytes(data, i * 4096 + 1));
+    }
+
+    // the same through prepareData / isDataAvail / getData
+    Block block{&io, file.fd};
+    AMFuture<std::vector<char>> future = AMAsync(AMLaunch::async, &Block::getData, &Block::isDataAvail, &Block::prepareData, block, 8192);
+    std::vector<char> data = future.get();
+    EXPECT_EQ(data.size(), 4096u);
+    EXPECT_TRUE(checkBytes(data, 8192));
+
+    void *tag = io.prepareRead(-1, 16, 0);
+    EXPECT_THROW(io.getData(tag), std::system_error);
+}
+
+TEST(AMFileIO, automatic)
+{
+    readMany(AMFileIO::Backend::automatic);
+}
+
+TEST(AMFileIO, threads)
+{
+    readMany(AMFileIO::Backend::threads);
+}
+
+int main(int argc, char **argv) {
+
+     ::testing::InitGoogleTest(&argc, argv);
+     return RUN_ALL_TESTS();
+}
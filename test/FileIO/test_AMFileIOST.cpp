@@ -0,0 +1,51 @@
+#define __EMSCRIPTEN__
+
+#include "../../AMFileIO.h"
+#include "gtest/gtest.h"
+#include <fcntl.h>
+#include <cstdlib>
+
+using namespace AMCore;
+
+class Block {
+public:
+    AMFileIO *io;
+    int fd;
+
+    std::vector<char> getData(void *tag)
+    {
+        return io->getData(tag);
+    }
+
+    bool isDataAvail(void *tag)
+    {
+        return io->isDataAvail(tag);
+    }
+
+    void *prepareData(std::uint64_t offset)
+    {
+        return io->prepareRead(fd, 4, offset);
+    }
+};
+
+TEST(AMFileIO, blocking)
+{
+    char name[] = "/tmp/AMFileIOXXXXXX";
+    int fd = mkstemp(name);
+    unlink(name);
+    EXPECT_EQ(write(fd, "abcdefgh", 8), 8);
+
+    AMFileIO io;
+    EXPECT_EQ(io.backend(), AMFileIO::Backend::blocking);
+    Block block{&io, fd};
+    AMFuture<std::vector<char>> future = AMAsync(AMLaunch::async, &Block::getData, &Block::isDataAvail, &Block::prepareData, block, 2);
+    EXPECT_EQ(future.get(), std::vector<char>({'c', 'd', 'e', 'f'}));
+    EXPECT_EQ(io.read(fd, 4, 6).get(), std::vector<char>({'g', 'h'}));
+    close(fd);
+}
+
+int main(int argc, char **argv) {
+
+     ::testing::InitGoogleTest(&argc, argv);
+     return RUN_ALL_TESTS();
+}
@@ -118,6 +118,286 @@ TEST(AMFuture, parallelTest)
     }
 }
 
+class SlowTest {
+public:
+    std::atomic<bool> *go;
+
+    int getData(void *mem)
+    {
+        return (int) (uintptr_t) mem;
+    }
+
+    bool isDataAvail(void *mem)
+    {
+        return true;
+    }
+
+    void *prepareData(int parameter)
+    {
+        while (!go->load()) {
+            std::this_thread::yield();
+        }
+        return (void *) (uintptr_t) parameter;
+    }
+
+    void getNothing(void *mem)
+    {
+    }
+
+    int getThrow(void *mem)
+    {
+        throw std::runtime_error("getData failed");
+    }
+};
+
+TEST(AMFuture, sharedState)
+{
+    EXPECT_EQ(sizeof(AMFuture<int>), sizeof(void *));
+
+    std::atomic<bool> go(false);
+    SlowTest s{&go};
+    AMFuture<int> future = AMAsync(
+        AMLaunch::async,
+        &SlowTest::getData,
+        &SlowTest::isDataAvail,
+        &SlowTest::prepareData,
+        s,
+        7
+        );
+    EXPECT_TRUE(future.valid());
+    EXPECT_EQ(future.wait_for(std::chrono::milliseconds(1)), AMFutureStatus::timeout);
+    go = true;
+    future.wait();
+    EXPECT_EQ(future.wait_for(std::chrono::seconds(0)), AMFutureStatus::ready);
+    EXPECT_EQ(future.get(), 7);
+    EXPECT_FALSE(future.valid());
+    EXPECT_THROW(future.get(), std::future_error);
+}
+
+TEST(AMFuture, voidAndException)
+{
+    std::atomic<bool> go(true);
+    SlowTest s{&go};
+    AMFuture<void> nothing = AMAsync(
+        AMLaunch::async,
+        &SlowTest::getNothing,
+        &SlowTest::isDataAvail,
+        &SlowTest::prepareData,
+        s,
+        1
+        );
+    AMFuture<int> failing = AMAsync(
+        AMLaunch::async,
+        &SlowTest::getThrow,
+        &SlowTest::isDataAvail,
+        &SlowTest::prepareData,
+        s,
+        2
+        );
+    nothing.get();
+    EXPECT_THROW(failing.get(), std::runtime_error);
+}
+
+TEST(AMFuture, deferred)
+{
+    std::atomic<bool> go(true);
+    SlowTest s{&go};
+    AMFuture<int> future = AMAsync(
+        AMLaunch::deferred,
+        &SlowTest::getData,
+        &SlowTest::isDataAvail,
+        &SlowTest::prepareData,
+        s,
+        3
+        );
+    EXPECT_EQ(future.wait_for(std::chrono::seconds(0)), AMFutureStatus::deferred);
+    EXPECT_EQ(future.get(), 3);
+}
+
+TEST(AMFuture, share)
+{
+    std::atomic<bool> go(false);
+    SlowTest s{&go};
+    AMFuture<int> future = AMAsync(
+        AMLaunch::async,
+        &SlowTest::getData,
+        &SlowTest::isDataAvail,
+        &SlowTest::prepareData,
+        s,
+        8
+        );
+    AMSharedFuture<int> shared = future.share();
+    EXPECT_FALSE(future.valid());
+    EXPECT_TRUE(shared.valid());
+    EXPECT_EQ(shared.wait_for(std::chrono::milliseconds(1)), AMFutureStatus::timeout);
+    AMSharedFuture<int> copy = shared;
+    std::atomic<int> sum(0);
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; ++i) {
+        readers.emplace_back([copy, &sum]() {
+            sum += copy.get();
+        });
+    }
+    go = true;
+    for (std::thread &reader: readers) {
+        reader.join();
+    }
+    EXPECT_EQ(sum.load(), 32);
+    EXPECT_EQ(shared.get(), 8);
+    EXPECT_EQ(shared.wait_for(std::chrono::seconds(0)), AMFutureStatus::ready);
+
+    AMSharedFuture<int> failed = AMAsync(
+        AMLaunch::deferred,
+        &SlowTest::getThrow,
+        &SlowTest::isDataAvail,
+        &SlowTest::prepareData,
+        s,
+        9
+        ).share();
+    EXPECT_EQ(failed.wait_for(std::chrono::seconds(0)), AMFutureStatus::deferred);
+    EXPECT_THROW(failed.get(), std::runtime_error);
+    EXPECT_THROW(failed.get(), std::runtime_error);
+
+    AMSharedFuture<void> empty;
+    EXPECT_FALSE(empty.valid());
+    EXPECT_THROW(empty.get(), std::future_error);
+}
+
+TEST(AMFuture, abandoned)
+{
+    std::atomic<bool> go(false);
+    SlowTest s{&go};
+    {
+        AMFuture<int> future = AMAsync(
+            AMLaunch::async,
+            &SlowTest::getData,
+            &SlowTest::isDataAvail,
+            &SlowTest::prepareData,
+            s,
+            4
+            );
+    }
+    EXPECT_FALSE(checkZombies());
+    EXPECT_FALSE(AMPump(std::chrono::microseconds(100)));
+    go = true;
+    while (!AMPump(std::chrono::microseconds(100))) {
+        std::this_thread::yield();
+    }
+}
+
+TEST(AMFuture, waitSet)
+{
+    const int count = 100;
+    std::vector<std::atomic<bool>> gates(count);
+    std::vector<SlowTest> tests;
+    std::vector<AMFuture<int>> futures;
+    AMWaitSet set;
+    for (int i = 0; i < count; ++i) {
+        gates[i] = false;
+        tests.push_back(SlowTest{&gates[i]});
+    }
+    for (int i = 0; i < count; ++i) {
+        futures.push_back(AMAsync(
+            AMLaunch::async,
+            &SlowTest::getData,
+            &SlowTest::isDataAvail,
+            &SlowTest::prepareData,
+            tests[i],
+            i
+            ));
+        EXPECT_EQ(set.add(futures.back()), (std::size_t) i);
+    }
+    EXPECT_TRUE(set.wait_any_for(std::chrono::milliseconds(1)).empty());
+
+    gates[42] = true;
+    const std::vector<std::size_t> &ready = set.wait_any();
+    ASSERT_EQ(ready.size(), 1u);
+    EXPECT_EQ(ready[0], 42u);
+    EXPECT_EQ(futures[42].get(), 42);
+    EXPECT_EQ(set.pending(), (std::size_t) count - 1);
+
+    for (int i = 0; i < count; ++i) {
+        gates[i] = true;
+    }
+    std::vector<std::size_t> rest = set.wait_all();
+    EXPECT_EQ(rest.size(), (std::size_t) count - 1);
+    EXPECT_EQ(set.pending(), 0u);
+    std::set<std::size_t> unique(rest.begin(), rest.end());
+    EXPECT_EQ(unique.size(), (std::size_t) count - 1);
+    EXPECT_EQ(unique.count(42), 0u);
+    for (std::size_t i: rest) {
+        EXPECT_EQ(futures[i].wait_for(std::chrono::seconds(0)), AMFutureStatus::ready);
+        EXPECT_EQ(futures[i].get(), (int) i);
+    }
+    EXPECT_TRUE(set.wait_any().empty());
+}
+
+TEST(AMFuture, incrementalZombies)
+{
+    const int count = 50;
+    std::atomic<bool> go(false);
+    SlowTest s{&go};
+    std::vector<AMFuture<int>> futures;
+    for (int i = 0; i < count; ++i) {
+        futures.push_back(AMAsync(
+            AMLaunch::async,
+            &SlowTest::getData,
+            &SlowTest::isDataAvail,
+            &SlowTest::prepareData,
+            s,
+            i
+            ));
+    }
+    futures.clear();
+    EXPECT_EQ(checkZombies(10), (std::size_t) count);
+    go = true;
+    std::size_t left = count;
+    while (left > 0) {
+        std::size_t now = checkZombies(10);
+        EXPECT_GE(now + 10, left);
+        left = now;
+    }
+    EXPECT_EQ(checkZombies(std::chrono::steady_clock::now()), 0u);
+    EXPECT_TRUE(checkZombies());
+}
+
+TEST(AMFuture, promise)
+{
+    AMPromise<int> promise;
+    AMFuture<int> future = promise.get_future();
+    EXPECT_THROW(promise.get_future(), std::future_error);
+    AMWaitSet set;
+    set.add(future);
+    std::thread producer([&promise]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        promise.set_value(5);
+    });
+    EXPECT_EQ(set.wait_any().size(), 1u);
+    EXPECT_EQ(future.get(), 5);
+    producer.join();
+    EXPECT_THROW(promise.set_value(6), std::future_error);
+
+    AMPromise<void> done;
+    AMFuture<void> doneFuture = done.get_future();
+    std::thread signal([&done]() {
+        done.set_value();
+    });
+    doneFuture.get();
+    signal.join();
+
+    AMFuture<int> broken;
+    {
+        AMPromise<int> p;
+        broken = p.get_future();
+    }
+    EXPECT_THROW(broken.get(), std::future_error);
+
+    AMPromise<int> failing;
+    AMFuture<int> failed = failing.get_future();
+    failing.set_exception(std::make_exception_ptr(std::runtime_error("no data")));
+    EXPECT_THROW(failed.get(), std::runtime_error);
+}
+
 int main(int argc, char **argv) {
 
      ::testing::InitGoogleTest(&argc, argv);
@@ -3,6 +3,7 @@
 #include "../../AMFuture.h"
 #include "gtest/gtest.h"
 #include <set>
+#include <thread>
 
 
 
@@ -123,6 +124,203 @@ TEST(AMFuture, parallelTest)
     }
 }
 
+TEST(AMFuture, waitSet)
+{
+    ParallelTest p;
+    AMWaitSet set;
+    AMFuture<int> future1 = AMAsync(
+        AMLaunch::async,
+        &ParallelTest::getData,
+        &ParallelTest::isDataAvail,
+        &ParallelTest::prepareData,
+        p,
+        1
+        );
+    AMFuture<int> future2 = AMAsync(
+        AMLaunch::async,
+        &ParallelTest::getData,
+        &ParallelTest::isDataAvail,
+        &ParallelTest::prepareData,
+        p,
+        2
+        );
+    EXPECT_EQ(set.add(future1), 0u);
+    EXPECT_EQ(set.add(future2), 1u);
+
+    std::vector<std::size_t> ready = set.wait_all();
+    EXPECT_EQ(ready.size(), 2u);
+    EXPECT_EQ(set.pending(), 0u);
+    EXPECT_TRUE(set.wait_any().empty());
+    EXPECT_EQ(future1.get(), 1);
+    EXPECT_EQ(future2.get(), 2);
+}
+
+class SlowTest {
+public:
+    int calls = 0;
+
+    int getData(void *mem)
+    {
+        return (int) (uintptr_t) mem;
+    }
+
+    bool isDataAvail(void *mem)
+    {
+        return true;
+    }
+
+    void *prepareData(int parameter)
+    {
+        ++calls;
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        return (void *) (uintptr_t) parameter;
+    }
+};
+
+TEST(AMFuture, pump)
+{
+    SlowTest s;
+    std::vector<AMFuture<int>> futures;
+    for (int i = 0; i < 10; ++i) {
+        futures.push_back(AMAsync(
+            AMLaunch::async,
+            &SlowTest::getData,
+            &SlowTest::isDataAvail,
+            &SlowTest::prepareData,
+            s,
+            i
+            ));
+    }
+    EXPECT_EQ(s.calls, 0);
+    EXPECT_FALSE(futures[0].valid());
+
+    EXPECT_FALSE(AMPump(std::chrono::microseconds(0)));
+    EXPECT_EQ(s.calls, 1);
+    EXPECT_TRUE(futures[0].valid());
+    EXPECT_EQ(futures[0].get(), 0);
+
+    // get() runs its own call, when it has not been pumped yet
+    EXPECT_EQ(futures[9].get(), 9);
+    EXPECT_EQ(s.calls, 2);
+
+    futures.resize(5);
+    while (!AMPump(std::chrono::microseconds(3000))) {
+    }
+    EXPECT_EQ(s.calls, 10);
+    for (int i = 1; i < 5; ++i) {
+        EXPECT_EQ(futures[i].get(), i);
+    }
+}
+
+class LateTest {
+public:
+    bool avail = false;
+
+    int getData(void *mem)
+    {
+        return 0;
+    }
+
+    bool isDataAvail(void *mem)
+    {
+        return avail;
+    }
+
+    void *prepareData(int parameter)
+    {
+        return nullptr;
+    }
+};
+
+TEST(AMFuture, incrementalZombies)
+{
+    LateTest l;
+    {
+        std::vector<AMFuture<int>> futures;
+        for (int i = 0; i < 10; ++i) {
+            futures.push_back(AMAsync(
+                AMLaunch::async,
+                &LateTest::getData,
+                &LateTest::isDataAvail,
+                &LateTest::prepareData,
+                l,
+                i
+                ));
+        }
+        EXPECT_TRUE(AMPump(std::chrono::microseconds(10000)));
+    }
+    EXPECT_EQ(checkZombies(3), 10u);
+    l.avail = true;
+    EXPECT_EQ(checkZombies(3), 7u);
+    EXPECT_EQ(checkZombies(3), 4u);
+    EXPECT_EQ(checkZombies(std::chrono::steady_clock::now()), 3u);
+    EXPECT_TRUE(checkZombies());
+}
+
+TEST(AMFuture, waitSetNotAvail)
+{
+    LateTest l;
+    AMWaitSet set;
+    AMFuture<int> future = AMAsync(
+        AMLaunch::async,
+        &LateTest::getData,
+        &LateTest::isDataAvail,
+        &LateTest::prepareData,
+        l,
+        1
+        );
+    set.add(future);
+    EXPECT_EQ(set.pending(), 1u);
+    EXPECT_TRUE(set.wait_any().empty());
+    EXPECT_EQ(set.pending(), 1u);
+    l.avail = true;
+    EXPECT_EQ(set.wait_any().size(), 1u);
+    EXPECT_EQ(set.pending(), 0u);
+    EXPECT_EQ(future.get(), 0);
+}
+
+TEST(AMFuture, queuedZombies)
+{
+    LateTest l;
+    l.avail = true;
+    {
+        AMFuture<int> future = AMAsync(
+            AMLaunch::async,
+            &LateTest::getData,
+            &LateTest::isDataAvail,
+            &LateTest::prepareData,
+            l,
+            1
+            );
+    }
+    // the call has not been pumped, checkZombies() runs it
+    EXPECT_TRUE(checkZombies());
+    EXPECT_TRUE(AMPump(std::chrono::microseconds(0)));
+}
+
+TEST(AMFuture, promise)
+{
+    AMPromise<int> promise;
+    AMFuture<int> future = promise.get_future();
+    AMWaitSet set;
+    set.add(future);
+    EXPECT_FALSE(future.valid());
+    EXPECT_EQ(future.wait_for(std::chrono::seconds(0)), AMFutureStatus::timeout);
+    EXPECT_TRUE(set.wait_any().empty());
+
+    promise.set_value(5);
+    EXPECT_TRUE(future.valid());
+    EXPECT_EQ(set.wait_any().size(), 1u);
+    EXPECT_EQ(future.get(), 5);
+
+    AMFuture<int> broken;
+    {
+        AMPromise<int> p;
+        broken = p.get_future();
+    }
+    EXPECT_THROW(broken.get(), std::logic_error);
+}
+
 int main(int argc, char **argv) {
 
      ::testing::InitGoogleTest(&argc, argv);
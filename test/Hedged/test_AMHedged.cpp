@@ -0,0 +1,99 @@
+#include "../../AMHedged.h"
+#include "gtest/gtest.h"
+#include <thread>
+
+using namespace AMCore;
+
+/**
+ * The first call is slow, all others are fast.
+ */
+class TailTest {
+public:
+    std::atomic<int> *calls;
+    std::atomic<bool> *release;
+
+    int getData(void *mem)
+    {
+        return (int) (intptr_t) mem;
+    }
+
+    bool isDataAvail(void *mem)
+    {
+        return true;
+    }
+
+    void *prepareData(int parameter)
+    {
+        if (calls->fetch_add(1) == 0) {
+            while (!*release) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            return (void *) (intptr_t) -parameter;
+        }
+        return (void *) (intptr_t) parameter;
+    }
+};
+
+TEST(AMHedged, slowFirstAttempt)
+{
+    std::atomic<int> calls(0);
+    std::atomic<bool> release(false);
+    TailTest t{&calls, &release};
+    AMHedgePolicy policy(std::chrono::milliseconds(5));
+    AMFuture<int> future = AMAsyncHedged(policy, &TailTest::getData, &TailTest::isDataAvail, &TailTest::prepareData, t, 7);
+    EXPECT_EQ(future.get(), 7);
+    EXPECT_EQ(policy.hedges(), 1u);
+    EXPECT_EQ(calls, 2);
+
+    // the loser still runs, so it is kept with zombies
+    EXPECT_FALSE(checkZombies());
+    release = true;
+    while (!checkZombies()) {
+        std::this_thread::yield();
+    }
+}
+
+TEST(AMHedged, fastFirstAttempt)
+{
+    std::atomic<int> calls(1);
+    std::atomic<bool> release(true);
+    TailTest t{&calls, &release};
+    AMHedgePolicy policy(std::chrono::seconds(10));
+    {
+        AMFuture<int> future = AMAsyncHedged(policy, &TailTest::getData, &TailTest::isDataAvail, &TailTest::prepareData, t, 3);
+        EXPECT_EQ(future.get(), 3);
+    }
+    while (!checkZombies()) {
+        std::this_thread::yield();
+    }
+    EXPECT_EQ(policy.hedges(), 0u);
+    EXPECT_EQ(calls, 2);
+}
+
+TEST(AMHedged, percentile)
+{
+    AMHedgePolicy policy(0.9, std::chrono::milliseconds(50), 100);
+    EXPECT_EQ(policy.delay(), std::chrono::milliseconds(50));
+    for (int i = 1; i <= 100; ++i) {
+        policy.record(std::chrono::microseconds(i * 10));
+    }
+    EXPECT_EQ(policy.delay(), std::chrono::microseconds(900));
+    for (int i = 1; i <= 100; ++i) {
+        policy.record(std::chrono::microseconds(i));
+    }
+    EXPECT_EQ(policy.delay(), std::chrono::microseconds(90));
+
+    // computed again after a quarter of window
+    for (int i = 1; i < 25; ++i) {
+        policy.record(std::chrono::microseconds(1000));
+    }
+    EXPECT_EQ(policy.delay(), std::chrono::microseconds(90));
+    policy.record(std::chrono::microseconds(1000));
+    EXPECT_EQ(policy.delay(), std::chrono::microseconds(1000));
+}
+
+int main(int argc, char **argv) {
+
+     ::testing::InitGoogleTest(&argc, argv);
+     return RUN_ALL_TESTS();
+}
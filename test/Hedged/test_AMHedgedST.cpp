@@ -0,0 +1,63 @@
+#define __EMSCRIPTEN__
+
+#include "../../AMHedged.h"
+#include "gtest/gtest.h"
+
+using namespace AMCore;
+
+/**
+ * Data of the first call are late, data of others are available at once.
+ */
+class TailTest {
+public:
+    int calls;
+    bool late;
+
+    int getData(void *mem)
+    {
+        return (int) (intptr_t) mem;
+    }
+
+    bool isDataAvail(void *mem)
+    {
+        return (intptr_t) mem > 1 || !late;
+    }
+
+    void *prepareData()
+    {
+        return (void *) (intptr_t) ++calls;
+    }
+};
+
+TEST(AMHedged, slowFirstAttempt)
+{
+    TailTest t{0, true};
+    AMHedgePolicy policy(std::chrono::milliseconds(2));
+    AMFuture<int> future = AMAsyncHedged(policy, &TailTest::getData, &TailTest::isDataAvail, &TailTest::prepareData, t);
+    EXPECT_EQ(future.wait_for(std::chrono::milliseconds(1)), AMFutureStatus::timeout);
+    EXPECT_EQ(t.calls, 1);
+    EXPECT_EQ(future.wait_for(std::chrono::seconds(1)), AMFutureStatus::ready);
+    EXPECT_EQ(future.get(), 2);
+    EXPECT_EQ(policy.hedges(), 1u);
+
+    EXPECT_FALSE(checkZombies());
+    t.late = false;
+    EXPECT_TRUE(checkZombies());
+}
+
+TEST(AMHedged, fastFirstAttempt)
+{
+    TailTest t{0, false};
+    AMHedgePolicy policy(std::chrono::seconds(10));
+    AMFuture<int> future = AMAsyncHedged(policy, &TailTest::getData, &TailTest::isDataAvail, &TailTest::prepareData, t);
+    EXPECT_EQ(future.get(), 1);
+    EXPECT_EQ(t.calls, 1);
+    EXPECT_EQ(policy.hedges(), 0u);
+    EXPECT_TRUE(checkZombies());
+}
+
+int main(int argc, char **argv) {
+
+     ::testing::InitGoogleTest(&argc, argv);
+     return RUN_ALL_TESTS();
+}
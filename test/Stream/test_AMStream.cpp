@@ -0,0 +1,78 @@
+#include "../../AMStream.h"
+#include "gtest/gtest.h"
+#include <thread>
+
+using namespace AMCore;
+
+class Counter {
+public:
+    std::atomic<int> *pushed;
+
+    void produce(AMStreamWriter<int> &out, int count)
+    {
+        for (int i = 0; i < count; ++i) {
+            if (!out.push(i)) {
+                return;
+            }
+            ++*pushed;
+        }
+    }
+
+    void fail(AMStreamWriter<int> &out, int count)
+    {
+        produce(out, count);
+        throw std::runtime_error("producer failed");
+    }
+};
+
+TEST(AMStream, order)
+{
+    std::atomic<int> pushed(0);
+    Counter c{&pushed};
+    AMStream<int> stream = AMAsyncStream<int>(4, &Counter::produce, c, 10000);
+    int expected = 0;
+    for (int i: stream) {
+        EXPECT_EQ(i, expected);
+        ++expected;
+    }
+    EXPECT_EQ(expected, 10000);
+    EXPECT_FALSE(stream.valid());
+    EXPECT_FALSE(stream.next());
+}
+
+TEST(AMStream, backpressure)
+{
+    std::atomic<int> pushed(0);
+    Counter c{&pushed};
+    {
+        AMStream<int> stream = AMAsyncStream<int>(2, &Counter::produce, c, 100);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        EXPECT_EQ(pushed, 2);
+        EXPECT_EQ(stream.next(), 0);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        EXPECT_EQ(pushed, 3);
+    }
+    // consumer is gone, the producer stops
+    while (!checkZombies()) {
+        std::this_thread::yield();
+    }
+    EXPECT_EQ(pushed, 3);
+}
+
+TEST(AMStream, exception)
+{
+    std::atomic<int> pushed(0);
+    Counter c{&pushed};
+    AMStream<int> stream = AMAsyncStream<int>(16, &Counter::fail, c, 3);
+    EXPECT_EQ(stream.next(), 0);
+    EXPECT_EQ(stream.next(), 1);
+    EXPECT_EQ(stream.next(), 2);
+    EXPECT_THROW(stream.next(), std::runtime_error);
+    EXPECT_FALSE(stream.valid());
+}
+
+int main(int argc, char **argv) {
+
+     ::testing::InitGoogleTest(&argc, argv);
+     return RUN_ALL_TESTS();
+}
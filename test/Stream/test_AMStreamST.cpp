@@ -0,0 +1,51 @@
+#define __EMSCRIPTEN__
+
+#include "../../AMStream.h"
+#include "gtest/gtest.h"
+
+using namespace AMCore;
+
+class Counter {
+public:
+    int pushed;
+
+    void produce(AMStreamWriter<int> &out, int count)
+    {
+        for (int i = 0; i < count; ++i) {
+            if (!out.push(i)) {
+                return;
+            }
+            ++pushed;
+        }
+    }
+};
+
+TEST(AMStream, order)
+{
+    Counter c{0};
+    AMStream<int> stream = AMAsyncStream<int>(4, &Counter::produce, c, 100);
+    EXPECT_EQ(c.pushed, 0);
+    int expected = 0;
+    for (int i: stream) {
+        EXPECT_EQ(i, expected);
+        ++expected;
+    }
+    EXPECT_EQ(expected, 100);
+    EXPECT_EQ(c.pushed, 100);
+}
+
+TEST(AMStream, abandoned)
+{
+    Counter c{0};
+    {
+        AMStream<int> stream = AMAsyncStream<int>(4, &Counter::produce, c, 100);
+    }
+    EXPECT_TRUE(AMPump(std::chrono::microseconds(1000)));
+    EXPECT_EQ(c.pushed, 0);
+}
+
+int main(int argc, char **argv) {
+
+     ::testing::InitGoogleTest(&argc, argv);
+     return RUN_ALL_TESTS();
+}
@@ -0,0 +1,159 @@
+#include "../../AMTaskGraph.h"
+#include "../../AMTimerWheel.h"
+#include "gtest/gtest.h"
+#include <thread>
+
+using namespace AMCore;
+
+class Sum {
+public:
+    AMTaskGraph *graph;
+    std::vector<AMTaskNode<int>> inputs;
+    int value;
+
+    int getData(void *mem)
+    {
+        return (int) (intptr_t) mem;
+    }
+
+    bool isDataAvail(void *mem)
+    {
+        return true;
+    }
+
+    void *prepareData()
+    {
+        int sum = value;
+        for (AMTaskNode<int> input: inputs) {
+            sum += graph->result(input);
+        }
+        return (void *) (intptr_t) sum;
+    }
+};
+
+TEST(AMTaskGraph, diamond)
+{
+    AMTaskGraph graph;
+    Sum a{&graph, {}, 1};
+    AMTaskNode<int> na = graph.add(&Sum::getData, &Sum::isDataAvail, &Sum::prepareData, a);
+    Sum b{&graph, {na}, 10};
+    AMTaskNode<int> nb = graph.add(&Sum::getData, &Sum::isDataAvail, &Sum::prepareData, b);
+    Sum c{&graph, {na}, 100};
+    AMTaskNode<int> nc = graph.add(&Sum::getData, &Sum::isDataAvail, &Sum::prepareData, c);
+    Sum d{&graph, {nb, nc}, 1000};
+    AMTaskNode<int> nd = graph.add(&Sum::getData, &Sum::isDataAvail, &Sum::prepareData, d);
+    graph.precede(na, nb);
+    graph.precede(na, nc);
+    graph.precede(nb, nd);
+    graph.precede(nc, nd);
+
+    for (int i = 0; i < 3; ++i) {
+        AMFuture<void> run = graph.run();
+        run.get();
+        EXPECT_EQ(graph.result(na), 1);
+        EXPECT_EQ(graph.result(nb), 11);
+        EXPECT_EQ(graph.result(nc), 101);
+        EXPECT_EQ(graph.result(nd), 1112);
+    }
+}
+
+class Meet {
+public:
+    std::atomic<int> *arrived;
+
+    bool getData(void *mem)
+    {
+        return mem != nullptr;
+    }
+
+    bool isDataAvail(void *mem)
+    {
+        return true;
+    }
+
+    void *prepareData()
+    {
+        arrived->fetch_add(1);
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (arrived->load() < 2) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                return nullptr;
+            }
+            std::this_thread::yield();
+        }
+        return this;
+    }
+
+    void *fail()
+    {
+        throw std::runtime_error("prepareData failed");
+    }
+};
+
+TEST(AMTaskGraph, parallelBranches)
+{
+    std::atomic<int> arrived(0);
+    Meet m{&arrived};
+    AMTaskGraph graph;
+    AMTaskNode<bool> n1 = graph.add(&Meet::getData, &Meet::isDataAvail, &Meet::prepareData, m);
+    AMTaskNode<bool> n2 = graph.add(&Meet::getData, &Meet::isDataAvail, &Meet::prepareData, m);
+    graph.run().get();
+    EXPECT_TRUE(graph.result(n1));
+    EXPECT_TRUE(graph.result(n2));
+}
+
+TEST(AMTaskGraph, failure)
+{
+    std::atomic<int> arrived(2);
+    Meet m{&arrived};
+    AMTaskGraph graph;
+    AMTaskNode<bool> n1 = graph.add(&Meet::getData, &Meet::isDataAvail, &Meet::fail, m);
+    AMTaskNode<bool> n2 = graph.add(&Meet::getData, &Meet::isDataAvail, &Meet::prepareData, m);
+    graph.precede(n1, n2);
+    EXPECT_THROW(graph.run().get(), std::runtime_error);
+    EXPECT_EQ(arrived.load(), 2);
+    EXPECT_THROW(graph.result(n1), std::logic_error);
+    EXPECT_THROW(graph.result(n2), std::logic_error);
+}
+
+TEST(AMTaskGraph, cycle)
+{
+    std::atomic<int> arrived(2);
+    Meet m{&arrived};
+    AMTaskGraph graph;
+    AMTaskNode<bool> n1 = graph.add(&Meet::getData, &Meet::isDataAvail, &Meet::prepareData, m);
+    AMTaskNode<bool> n2 = graph.add(&Meet::getData, &Meet::isDataAvail, &Meet::prepareData, m);
+    graph.precede(n1, n2);
+    graph.precede(n2, n1);
+    EXPECT_THROW(graph.run(), std::logic_error);
+    EXPECT_THROW(graph.run(), std::logic_error);
+}
+
+TEST(AMTaskGraph, expiredRun)
+{
+    std::atomic<int> arrived(0);
+    Meet m{&arrived};
+    AMTimerWheel wheel;
+    std::thread late;
+    {
+        AMTaskGraph graph;
+        AMTaskNode<bool> n1 = graph.add(&Meet::getData, &Meet::isDataAvail, &Meet::prepareData, m);
+        AMFuture<void> run = graph.run();
+        wheel.expire(run, std::chrono::steady_clock::now());
+        wheel.advance(std::chrono::steady_clock::now() + std::chrono::milliseconds(10));
+        EXPECT_THROW(run.get(), AMFutureTimeout);
+        late = std::thread([&arrived]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            arrived.fetch_add(1);
+        });
+        // the node still runs, destructor of the graph waits for it
+    }
+    EXPECT_EQ(arrived.load(), 2);
+    late.join();
+}
+
+int main(int argc, char **argv) {
+
+     ::testing::InitGoogleTest(&argc, argv);
+     return RUN_ALL_TESTS();
+}
@@ -0,0 +1,89 @@
+#define __EMSCRIPTEN__
+
+#include "../../AMTaskGraph.h"
+#include "gtest/gtest.h"
+
+using namespace AMCore;
+
+class Sum {
+public:
+    AMTaskGraph *graph;
+    std::vector<AMTaskNode<int>> inputs;
+    int value;
+    int *polls;
+
+    int getData(void *mem)
+    {
+        return (int) (intptr_t) mem;
+    }
+
+    bool isDataAvail(void *mem)
+    {
+        return ++*polls > 1;
+    }
+
+    void *prepareData()
+    {
+        *polls = 0;
+        int sum = value;
+        for (AMTaskNode<int> input: inputs) {
+            sum += graph->result(input);
+        }
+        return (void *) (intptr_t) sum;
+    }
+};
+
+TEST(AMTaskGraph, diamond)
+{
+    int pa, pb, pc, pd;
+    AMTaskGraph graph;
+    Sum a{&graph, {}, 1, &pa};
+    AMTaskNode<int> na = graph.add(&Sum::getData, &Sum::isDataAvail, &Sum::prepareData, a);
+    Sum b{&graph, {na}, 10, &pb};
+    AMTaskNode<int> nb = graph.add(&Sum::getData, &Sum::isDataAvail, &Sum::prepareData, b);
+    Sum c{&graph, {na}, 100, &pc};
+    AMTaskNode<int> nc = graph.add(&Sum::getData, &Sum::isDataAvail, &Sum::prepareData, c);
+    Sum d{&graph, {nb, nc}, 1000, &pd};
+    AMTaskNode<int> nd = graph.add(&Sum::getData, &Sum::isDataAvail, &Sum::prepareData, d);
+    graph.precede(na, nb);
+    graph.precede(na, nc);
+    graph.precede(nb, nd);
+    graph.precede(nc, nd);
+
+    // get() runs the queue itself
+    graph.run().get();
+    EXPECT_EQ(graph.result(nd), 1112);
+
+    // or AMPump() runs it frame by frame
+    AMFuture<void> run = graph.run();
+    int frames = 0;
+    while (!AMPump(std::chrono::microseconds(0))) {
+        ++frames;
+    }
+    EXPECT_GT(frames, 2);
+    EXPECT_TRUE(run.valid());
+    run.get();
+    EXPECT_EQ(graph.result(nb), 11);
+    EXPECT_EQ(graph.result(nc), 101);
+    EXPECT_EQ(graph.result(nd), 1112);
+}
+
+TEST(AMTaskGraph, cycle)
+{
+    int pa, pb;
+    AMTaskGraph graph;
+    Sum a{&graph, {}, 1, &pa};
+    AMTaskNode<int> na = graph.add(&Sum::getData, &Sum::isDataAvail, &Sum::prepareData, a);
+    Sum b{&graph, {}, 10, &pb};
+    AMTaskNode<int> nb = graph.add(&Sum::getData, &Sum::isDataAvail, &Sum::prepareData, b);
+    graph.precede(na, nb);
+    graph.precede(nb, na);
+    EXPECT_THROW(graph.run(), std::logic_error);
+    EXPECT_THROW(graph.result(na), std::logic_error);
+}
+
+int main(int argc, char **argv) {
+
+     ::testing::InitGoogleTest(&argc, argv);
+     return RUN_ALL_TESTS();
+}
@@ -0,0 +1,77 @@
+#include "../../AMTimerWheel.h"
+#include "gtest/gtest.h"
+
+using namespace AMCore;
+
+TEST(AMTimerWheel, order)
+{
+    AMTimerWheel wheel;
+    AMTimerWheel::Clock::time_point now = AMTimerWheel::Clock::now();
+    std::vector<int> fired;
+    // deadlines across all levels of the wheel
+    const int delays[] = {5, 1, 70, 4100, 3, 300000, 70};
+    for (int delay: delays) {
+        wheel.arm(now + std::chrono::milliseconds(delay), [&fired, delay]() {
+            fired.push_back(delay);
+        });
+    }
+    AMTimer cancelled = wheel.arm(now + std::chrono::milliseconds(2), [&fired]() {
+        fired.push_back(-1);
+    });
+    EXPECT_EQ(wheel.size(), 8u);
+    EXPECT_TRUE(wheel.cancel(cancelled));
+    EXPECT_FALSE(wheel.cancel(cancelled));
+
+    // handle of recycled timer does not cancel its successor
+    AMTimer next = wheel.arm(now + std::chrono::seconds(1000), []() {});
+    EXPECT_EQ(next.index, cancelled.index);
+    EXPECT_FALSE(wheel.cancel(cancelled));
+    EXPECT_TRUE(wheel.cancel(next));
+
+    EXPECT_EQ(wheel.advance(now), 0u);
+    EXPECT_EQ(wheel.advance(now + std::chrono::milliseconds(6)), 3u);
+    EXPECT_EQ(wheel.advance(now + std::chrono::milliseconds(69)), 0u);
+    EXPECT_EQ(wheel.advance(now + std::chrono::milliseconds(71)), 2u);
+    EXPECT_EQ(wheel.advance(now + std::chrono::seconds(400)), 2u);
+    EXPECT_EQ(wheel.size(), 0u);
+    EXPECT_EQ(fired, std::vector<int>({1, 3, 5, 70, 70, 4100, 300000}));
+}
+
+TEST(AMTimerWheel, expire)
+{
+    AMTimerWheel wheel;
+    wheel.start();
+
+    AMPromise<int> late;
+    AMFuture<int> expired = late.get_future();
+    wheel.expire(expired, AMTimerWheel::Clock::now() + std::chrono::milliseconds(5));
+    expired.wait();
+    EXPECT_THROW(expired.get(), AMFutureTimeout);
+    late.set_value(1);
+
+    AMPromise<int> early;
+    AMFuture<int> future = early.get_future();
+    AMTimer timer = wheel.expire(future, AMTimerWheel::Clock::now() + std::chrono::seconds(10));
+    early.set_value(2);
+    EXPECT_EQ(future.get(), 2);
+    EXPECT_TRUE(wheel.cancel(timer));
+
+    // deadlines of many futures share one thread
+    std::vector<AMPromise<void>> promises(1000);
+    std::vector<AMFuture<void>> futures;
+    for (std::size_t i = 0; i < promises.size(); ++i) {
+        futures.push_back(promises[i].get_future());
+        wheel.expire(futures.back(), AMTimerWheel::Clock::now() + std::chrono::milliseconds(i % 20));
+    }
+    for (AMFuture<void> &f: futures) {
+        EXPECT_THROW(f.get(), AMFutureTimeout);
+    }
+    wheel.stop();
+    EXPECT_EQ(wheel.size(), 0u);
+}
+
+int main(int argc, char **argv) {
+
+     ::testing::InitGoogleTest(&argc, argv);
+     return RUN_ALL_TESTS();
+}
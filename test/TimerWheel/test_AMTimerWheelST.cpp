@@ -0,0 +1,60 @@
+#define __EMSCRIPTEN__
+
+#include "../../AMTimerWheel.h"
+#include "gtest/gtest.h"
+
+using namespace AMCore;
+
+class NeverTest {
+public:
+    int getData(void *mem)
+    {
+        return 0;
+    }
+
+    bool isDataAvail(void *mem)
+    {
+        return false;
+    }
+
+    void *prepareData()
+    {
+        return nullptr;
+    }
+};
+
+TEST(AMTimerWheel, expire)
+{
+    NeverTest n;
+    AMTimerWheel wheel;
+    AMFuture<int> future = AMAsync(
+        AMLaunch::async,
+        &NeverTest::getData,
+        &NeverTest::isDataAvail,
+        &NeverTest::prepareData,
+        n
+        );
+    wheel.expire(future, AMTimerWheel::Clock::now() + std::chrono::milliseconds(3));
+
+    // wait_for waits for its duration
+    AMTimerWheel::Clock::time_point start = AMTimerWheel::Clock::now();
+    EXPECT_EQ(future.wait_for(std::chrono::milliseconds(2)), AMFutureStatus::timeout);
+    EXPECT_GE(AMTimerWheel::Clock::now() - start, std::chrono::milliseconds(2));
+
+    // frame loop
+    int frames = 0;
+    while (wheel.advance() == 0) {
+        AMPump(std::chrono::microseconds(100));
+        ++frames;
+    }
+    EXPECT_GT(frames, 0);
+    EXPECT_TRUE(future.valid());
+    EXPECT_THROW(future.get(), AMFutureTimeout);
+    EXPECT_TRUE(checkZombies());
+}
+
+int main(int argc, char **argv) {
+
+     ::testing::InitGoogleTest(&argc, argv);
+     return RUN_ALL_TESTS();
+}
@@ -0,0 +1,162 @@
+#include "../../AMWatchdog.h"
+#include "../../AMExecutor.h"
+#include "gtest/gtest.h"
+#include <thread>
+#include <cstring>
+
+using namespace AMCore;
+
+/**
+ * prepareData waits, until the test releases it.
+ */
+class StuckTest {
+public:
+    std::atomic<bool> *release;
+
+    int getData(void *mem)
+    {
+        return (int) (intptr_t) mem;
+    }
+
+    bool isDataAvail(void *)
+    {
+        return true;
+    }
+
+    void *prepareData(int parameter)
+    {
+        while (!*release) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return (void *) (intptr_t) parameter;
+    }
+};
+
+static std::string dumpText()
+{
+    int fds[2];
+    EXPECT_EQ(pipe(fds), 0);
+    AMWatchdog::dump(fds[1]);
+    close(fds[1]);
+    std::string text;
+    char buffer[256];
+    ssize_t n;
+    while ((n = read(fds[0], buffer, sizeof(buffer))) > 0) {
+        text.append(buffer, (std::size_t) n);
+    }
+    close(fds[0]);
+    return text;
+}
+
+TEST(AMWatchdog, stuckCall)
+{
+    std::vector<AMWatchRecord> reported;
+    AMWatchdog watchdog(std::chrono::milliseconds(5), [&reported](const AMWatchRecord &record) {
+        reported.push_back(record);
+    });
+    std::atomic<bool> release(false);
+    StuckTest t{&release};
+    AMFuture<int> stuck;
+    {
+        AMWatchSite site("stuck loader");
+        stuck = AMAsync(AMLaunch::async, &StuckTest::getData, &StuckTest::isDataAvail, &StuckTest::prepareData, t, 1);
+    }
+    EXPECT_EQ(AMWatchdog::snapshot().size(), 1u);
+    while (watchdog.scan() == 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_EQ(reported.size(), 1u);
+    EXPECT_STREQ(reported[0].site, "stuck loader");
+    EXPECT_GE(reported[0].age, std::chrono::milliseconds(5));
+    EXPECT_FALSE(reported[0].zombie);
+    // each call is reported once
+    EXPECT_EQ(watchdog.scan(), 0u);
+
+    // abandoned call stays listed as zombie
+    stuck = AMFuture<int>();
+    std::vector<AMWatchRecord> records = AMWatchdog::snapshot();
+    ASSERT_EQ(records.size(), 1u);
+    EXPECT_TRUE(records[0].zombie);
+    EXPECT_NE(dumpText().find(" zombie at stuck loader\n"), std::string::npos);
+
+    release = true;
+    while (!checkZombies()) {
+        std::this_thread::yield();
+    }
+    EXPECT_TRUE(AMWatchdog::snapshot().empty());
+    EXPECT_EQ(dumpText(), "");
+}
+
+TEST(AMWatchdog, finishedCalls)
+{
+    AMWatchdog::enable();
+    std::atomic<bool> release(true);
+    StuckTest t{&release};
+    std::vector<AMFuture<int>> futures;
+    for (int i = 0; i < 100; ++i) {
+        futures.push_back(AMAsync(AMLaunch::async, &StuckTest::getData, &StuckTest::isDataAvail, &StuckTest::prepareData, t, i));
+    }
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(futures[i].get(), i);
+    }
+    EXPECT_TRUE(AMWatchdog::snapshot().empty());
+
+    // calls launched, while disabled, are not watched
+    AMWatchdog::disable();
+    release = false;
+    AMFuture<int> future = AMAsync(AMLaunch::async, &StuckTest::getData, &StuckTest::isDataAvail, &StuckTest::prepareData, t, 1);
+    EXPECT_TRUE(AMWatchdog::snapshot().empty());
+    release = true;
+    EXPECT_EQ(future.get(), 1);
+}
+
+TEST(AMWatchdog, callSite)
+{
+    AMWatchdog::enable();
+    std::atomic<bool> release(false);
+    StuckTest t{&release};
+    int line = __LINE__ + 1;
+    AMFuture<int> future = AMAsync(AMLaunch::async, &StuckTest::getData, &StuckTest::isDataAvail, &StuckTest::prepareData, t, 1);
+    std::vector<AMWatchRecord> records = AMWatchdog::snapshot();
+    ASSERT_EQ(records.size(), 1u);
+    EXPECT_NE(std::string(records[0].site).find("test_AMWatchdog.cpp"), std::string::npos);
+    EXPECT_EQ(records[0].line, line);
+    EXPECT_NE(dumpText().find("test_AMWatchdog.cpp:" + std::to_string(line) + "\n"), std::string::npos);
+    release = true;
+    EXPECT_EQ(future.get(), 1);
+
+    // executor is deduced, so its calls are named by type of prepareData
+    AMManualExecutor executor;
+    AMFuture<int> queued = AMAsync(executor, &StuckTest::getData, &StuckTest::isDataAvail, &StuckTest::prepareData, t, 2);
+    records = AMWatchdog::snapshot();
+    ASSERT_EQ(records.size(), 1u);
+    EXPECT_NE(std::string(records[0].site).find("StuckTest::"), std::string::npos);
+    EXPECT_EQ(records[0].line, 0);
+    executor.run_one();
+    EXPECT_EQ(queued.get(), 2);
+}
+
+TEST(AMWatchdog, scanningThread)
+{
+    std::atomic<int> reported(0);
+    AMWatchdog watchdog(std::chrono::milliseconds(2), [&reported](const AMWatchRecord &) {
+        ++reported;
+    });
+    watchdog.start(std::chrono::milliseconds(1));
+    std::atomic<bool> release(false);
+    StuckTest t{&release};
+    AMFuture<int> future = AMAsync(AMLaunch::async, &StuckTest::getData, &StuckTest::isDataAvail, &StuckTest::prepareData, t, 3);
+    while (reported == 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    release = true;
+    EXPECT_EQ(future.get(), 3);
+    watchdog.stop();
+    EXPECT_EQ(reported, 1);
+}
+
+int main(int argc, char **argv) {
+
+     ::testing::InitGoogleTest(&argc, argv);
+     return RUN_ALL_TESTS();
+}
@@ -0,0 +1,79 @@
+#define __EMSCRIPTEN__
+
+#include "../../AMWatchdog.h"
+#include "gtest/gtest.h"
+
+using namespace AMCore;
+
+/**
+ * Data are available, when the test says so.
+ */
+class StuckTest {
+public:
+    bool avail;
+
+    int getData(void *mem)
+    {
+        return (int) (intptr_t) mem;
+    }
+
+    bool isDataAvail(void *)
+    {
+        return avail;
+    }
+
+    void *prepareData(int parameter)
+    {
+        return (void *) (intptr_t) parameter;
+    }
+};
+
+TEST(AMWatchdog, stuckCall)
+{
+    std::vector<AMWatchRecord> reported;
+    AMWatchdog watchdog(std::chrono::milliseconds(2), [&reported](const AMWatchRecord &record) {
+        reported.push_back(record);
+    });
+    StuckTest t{false};
+    AMFuture<int> stuck;
+    {
+        AM_WATCH_SITE();
+        stuck = AMAsync(AMLaunch::async, &StuckTest::getData, &StuckTest::isDataAvail, &StuckTest::prepareData, t, 1);
+    }
+    EXPECT_EQ(stuck.wait_for(std::chrono::milliseconds(3)), AMFutureStatus::timeout);
+    EXPECT_EQ(watchdog.scan(), 1u);
+    ASSERT_EQ(reported.size(), 1u);
+    EXPECT_NE(std::string(reported[0].site).find("test_AMWatchdogST.cpp:"), std::string::npos);
+    EXPECT_EQ(watchdog.scan(), 0u);
+
+    stuck = AMFuture<int>();
+    std::vector<AMWatchRecord> records = AMWatchdog::snapshot();
+    ASSERT_EQ(records.size(), 1u);
+    EXPECT_TRUE(records[0].zombie);
+
+    t.avail = true;
+    EXPECT_TRUE(checkZombies());
+    EXPECT_TRUE(AMWatchdog::snapshot().empty());
+}
+
+TEST(AMWatchdog, defaultSite)
+{
+    AMWatchdog::enable();
+    StuckTest t{false};
+    int line = __LINE__ + 1;
+    AMFuture<int> future = AMAsync(AMLaunch::async, &StuckTest::getData, &StuckTest::isDataAvail, &StuckTest::prepareData, t, 2);
+    std::vector<AMWatchRecord> records = AMWatchdog::snapshot();
+    ASSERT_EQ(records.size(), 1u);
+    // without AMWatchSite, call is named by its file and line
+    EXPECT_NE(std::string(records[0].site).find("test_AMWatchdogST.cpp"), std::string::npos);
+    EXPECT_EQ(records[0].line, line);
+    t.avail = true;
+    EXPECT_EQ(future.get(), 2);
+    EXPECT_TRUE(AMWatchdog::snapshot().empty());
+}
+
+int main(int argc, char **argv) {
+
+     ::testing::InitGoogleTest(&argc, argv);
+     return RUN_ALL_TESTS();
+}